@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_buffer.c
+ * @brief Ring buffer of decoded audio between the decoder and the
+ *        audio output.
+ */
+
+#include "stdinc.h"
+
+#include <sys/mman.h>
+
+#include "audio_buffer.h"
+#include "config.h"
+
+/*
+ * The ring buffer has exactly one producer (the decoder thread) and one
+ * consumer (the audio output thread). The head is only modified by the
+ * producer and the tail only by the consumer, which means no locking
+ * is needed to pass chunks around. The mutex and conditional variable
+ * are only used when a thread actually has to go to sleep.
+ *
+ * Sleeping is done using an event counter. A thread first obtains the
+ * counter, checks whether it has anything to do and then waits for the
+ * counter to change. This prevents wakeups from getting lost.
+ */
+
+/**
+ * @brief The chunks stored in the ring buffer.
+ */
+static struct audio_chunk	*ab_chunks;
+/**
+ * @brief The amount of chunks stored in the ring buffer.
+ */
+static unsigned int		ab_len;
+/**
+ * @brief Index of the next chunk that will be written. It should only
+ *        be used with g_atomic_* operations.
+ */
+static volatile int		ab_head = 0;
+/**
+ * @brief Index of the next chunk that will be read. It should only be
+ *        used with g_atomic_* operations.
+ */
+static volatile int		ab_tail = 0;
+/**
+ * @brief Current flush generation. Chunks from previous generations
+ *        are discarded when read.
+ */
+static volatile int		ab_gen = 0;
+/**
+ * @brief Lowest fill percentage observed by the consumer.
+ */
+static volatile int		ab_lowest = 100;
+/**
+ * @brief Event counter that is incremented on each modification.
+ */
+static volatile int		ab_events = 0;
+/**
+ * @brief The amount of threads sleeping on the event counter.
+ */
+static volatile int		ab_waiters = 0;
+/**
+ * @brief Mutex used to sleep on the event counter.
+ */
+static GMutex			ab_mtx;
+/**
+ * @brief Conditional variable used to sleep on the event counter.
+ */
+static GCond			ab_cond;
+/**
+ * @brief Pipe that becomes readable when the buffer is flushed, so
+ *        audio outputs can stop waiting for the audio device.
+ */
+static int			ab_flushpipe[2] = { -1, -1 };
+
+/**
+ * @brief Increment the event counter and wake up sleeping threads.
+ */
+static void
+audio_buffer_notify(void)
+{
+	g_atomic_int_inc(&ab_events);
+
+	if (g_atomic_int_get(&ab_waiters) != 0) {
+		g_mutex_lock(&ab_mtx);
+		g_cond_broadcast(&ab_cond);
+		g_mutex_unlock(&ab_mtx);
+	}
+}
+
+/**
+ * @brief Return the amount of chunks that are currently filled.
+ */
+static inline unsigned int
+audio_buffer_used(void)
+{
+	return ((unsigned int)g_atomic_int_get(&ab_head) -
+	    (unsigned int)g_atomic_int_get(&ab_tail));
+}
+
+void
+audio_buffer_init(void)
+{
+	/* Buffer size is specified in kilobytes */
+	ab_len = (config_getopt_number("audio.buffer.size") * 1024) /
+	    sizeof(struct audio_chunk);
+	ab_len = MAX(ab_len, 2);
+	ab_chunks = g_new(struct audio_chunk, ab_len);
+
+	g_mutex_init(&ab_mtx);
+	g_cond_init(&ab_cond);
+
+	if (pipe(ab_flushpipe) == 0) {
+		/* Neither flushing nor draining may ever block */
+		fcntl(ab_flushpipe[0], F_SETFL, O_NONBLOCK);
+		fcntl(ab_flushpipe[1], F_SETFL, O_NONBLOCK);
+	}
+}
+
+int
+audio_buffer_mlock(void)
+{
+	return mlock(ab_chunks, ab_len * sizeof(struct audio_chunk));
+}
+
+struct audio_chunk *
+audio_buffer_write_begin(void)
+{
+	struct audio_chunk *ac;
+
+	if (audio_buffer_used() == ab_len)
+		return (NULL);
+
+	/* Audio decoded across a flush belongs to the old generation */
+	ac = &ab_chunks[(unsigned int)ab_head % ab_len];
+	ac->gen = g_atomic_int_get(&ab_gen);
+	return (ac);
+}
+
+void
+audio_buffer_write_end(void)
+{
+	g_atomic_int_inc(&ab_head);
+	audio_buffer_notify();
+}
+
+struct audio_chunk *
+audio_buffer_read_begin(void)
+{
+	struct audio_chunk *ac;
+	unsigned int used, fill;
+
+	while ((used = audio_buffer_used()) != 0) {
+		ac = &ab_chunks[(unsigned int)ab_tail % ab_len];
+
+		/* Markers may never be discarded */
+		if (ac->len == 0 ||
+		    ac->gen == (unsigned int)g_atomic_int_get(&ab_gen)) {
+			/* Keep track of the amount of headroom */
+			fill = (used * 100) / ab_len;
+			if (fill < (unsigned int)g_atomic_int_get(&ab_lowest))
+				g_atomic_int_set(&ab_lowest, fill);
+			return (ac);
+		}
+
+		/* Discarded by a flush */
+		audio_buffer_read_end();
+	}
+
+	return (NULL);
+}
+
+void
+audio_buffer_read_end(void)
+{
+	g_atomic_int_inc(&ab_tail);
+	audio_buffer_notify();
+}
+
+void
+audio_buffer_flush(void)
+{
+	char c = 0;
+
+	g_atomic_int_inc(&ab_gen);
+	audio_buffer_notify();
+
+	/* A full pipe is readable already */
+	if (ab_flushpipe[1] != -1)
+		(void)write(ab_flushpipe[1], &c, 1);
+}
+
+unsigned int
+audio_buffer_generation(void)
+{
+	return (g_atomic_int_get(&ab_gen));
+}
+
+int
+audio_buffer_flush_fd(void)
+{
+	char buf[64];
+
+	/* Discard notifications of earlier flushes */
+	if (ab_flushpipe[0] != -1)
+		while (read(ab_flushpipe[0], buf, sizeof buf) > 0) ;
+
+	return (ab_flushpipe[0]);
+}
+
+int
+audio_buffer_stale(const struct audio_chunk *ac)
+{
+	return (ac->len != 0 &&
+	    ac->gen != (unsigned int)g_atomic_int_get(&ab_gen));
+}
+
+unsigned int
+audio_buffer_events(void)
+{
+	return (g_atomic_int_get(&ab_events));
+}
+
+void
+audio_buffer_wait(unsigned int events)
+{
+	g_mutex_lock(&ab_mtx);
+	g_atomic_int_inc(&ab_waiters);
+	while ((unsigned int)g_atomic_int_get(&ab_events) == events)
+		g_cond_wait(&ab_cond, &ab_mtx);
+	g_atomic_int_add(&ab_waiters, -1);
+	g_mutex_unlock(&ab_mtx);
+}
+
+void
+audio_buffer_wakeup(void)
+{
+	audio_buffer_notify();
+}
+
+unsigned int
+audio_buffer_fill(void)
+{
+	return ((audio_buffer_used() * 100) / ab_len);
+}
+
+unsigned int
+audio_buffer_fill_lowest(void)
+{
+	return (g_atomic_int_get(&ab_lowest));
+}
+
+void
+audio_buffer_fill_reset(void)
+{
+	g_atomic_int_set(&ab_lowest, 100);
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_buffer.h
+ * @brief Ring buffer of decoded audio between the decoder and the
+ *        audio output.
+ */
+
+struct audio_file;
+
+/**
+ * @brief The amount of samples that fit in a single chunk.
+ */
+#define AUDIO_CHUNK_LEN		4096
+
+/**
+ * @brief A block of decoded audio stored in the ring buffer. Chunks
+ *        with a length of zero are markers, indicating that playback
+ *        of a new song starts (fd != NULL) or that the decoder went
+ *        idle (fd == NULL).
+ */
+struct audio_chunk {
+	/**
+	 * @brief Song that starts playing after this marker. The marker
+	 *        holds a reference to the audio file.
+	 */
+	struct audio_file *fd;
+	/**
+	 * @brief Sample rate of the audio.
+	 */
+	unsigned int	srate;
+	/**
+	 * @brief Amount of channels of the audio.
+	 */
+	unsigned int	channels;
+	/**
+	 * @brief Position of the first frame of the chunk in the song.
+	 */
+	int64_t		frame;
+	/**
+	 * @brief Flush generation the chunk belongs to.
+	 */
+	unsigned int	gen;
+	/**
+	 * @brief The amount of samples stored in the chunk.
+	 */
+	size_t		len;
+	/**
+	 * @brief Interleaved floating point audio samples, nominally in the
+	 *        range [-1.0, 1.0).
+	 */
+	float		buf[AUDIO_CHUNK_LEN];
+};
+
+/**
+ * @brief Allocate the ring buffer, using the size from the
+ *        configuration file.
+ */
+void audio_buffer_init(void);
+/**
+ * @brief Lock the ring buffer into physical memory, so playback does
+ *        not depend on paging.
+ */
+int audio_buffer_mlock(void);
+
+/**
+ * @brief Obtain the next free chunk, or NULL when the buffer is full.
+ *        The chunk belongs to the current flush generation, so it is
+ *        discarded when a flush occurs before it is played. Only the
+ *        decoder thread may call this function.
+ */
+struct audio_chunk *audio_buffer_write_begin(void);
+/**
+ * @brief Hand the chunk obtained through audio_buffer_write_begin()
+ *        over to the audio output.
+ */
+void audio_buffer_write_end(void);
+/**
+ * @brief Obtain the oldest filled chunk, or NULL when the buffer is
+ *        empty. Chunks discarded by audio_buffer_flush() are skipped.
+ *        Only the audio output thread may call this function.
+ */
+struct audio_chunk *audio_buffer_read_begin(void);
+/**
+ * @brief Release the chunk obtained through audio_buffer_read_begin().
+ */
+void audio_buffer_read_end(void);
+/**
+ * @brief Discard all audio that has not been played yet. Markers are
+ *        left intact.
+ */
+void audio_buffer_flush(void);
+/**
+ * @brief Return the current flush generation. It changes each time
+ *        audio_buffer_flush() is called.
+ */
+unsigned int audio_buffer_generation(void);
+/**
+ * @brief Return whether the chunk obtained through
+ *        audio_buffer_read_begin() has been discarded by a flush in
+ *        the mean time. Audio outputs use this to abort writing it.
+ */
+int audio_buffer_stale(const struct audio_chunk *ac);
+/**
+ * @brief Return a file descriptor that becomes readable when the buffer
+ *        is flushed, or -1 when unavailable. Audio outputs can poll it
+ *        while waiting for the audio device. Notifications of flushes
+ *        that happened before the call are discarded.
+ */
+int audio_buffer_flush_fd(void);
+
+/**
+ * @brief Return an event counter that changes each time the buffer is
+ *        modified or audio_buffer_wakeup() is called.
+ */
+unsigned int audio_buffer_events(void);
+/**
+ * @brief Sleep until the event counter differs from the value that
+ *        was obtained earlier.
+ */
+void audio_buffer_wait(unsigned int events);
+/**
+ * @brief Wake up all threads sleeping in audio_buffer_wait().
+ */
+void audio_buffer_wakeup(void);
+
+/**
+ * @brief Return the percentage of the buffer that is filled.
+ */
+unsigned int audio_buffer_fill(void);
+/**
+ * @brief Return the lowest fill percentage since the last call to
+ *        audio_buffer_fill_reset().
+ */
+unsigned int audio_buffer_fill_lowest(void);
+/**
+ * @brief Reset the lowest fill percentage.
+ */
+void audio_buffer_fill_reset(void);
@@ -0,0 +1,718 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_dsp.c
+ * @brief Sample processing routines used by the playback engine.
+ */
+
+#include "stdinc.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+/**
+ * @brief Build SSE2 versions of the conversion routines, which are
+ *        only used when the CPU supports them.
+ */
+#define DSP_SSE2
+#include <emmintrin.h>
+#endif /* __GNUC__ && (__i386__ || __x86_64__) */
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif /* __ARM_NEON */
+
+#include "audio_dsp.h"
+
+/**
+ * @brief Scale between floating point and 16 bits samples.
+ */
+#define DSP_S16_SCALE	32768.0f
+
+/**
+ * @brief Convert 16 bits samples to floating point in plain C.
+ */
+static void
+audio_dsp_from_s16_c(float *dst, const int16_t *src, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = src[i] * (1.0f / DSP_S16_SCALE);
+}
+
+/**
+ * @brief Convert floating point samples to 16 bits in plain C.
+ */
+static void
+audio_dsp_to_s16_c(int16_t *dst, const float *src, size_t len)
+{
+	size_t i;
+	float v;
+
+	for (i = 0; i < len; i++) {
+		v = src[i] * DSP_S16_SCALE;
+		if (v >= DSP_S16_SCALE - 1.0f)
+			dst[i] = SHRT_MAX;
+		else if (v <= -DSP_S16_SCALE)
+			dst[i] = SHRT_MIN;
+		else
+			dst[i] = v + (v >= 0.0f ? 0.5f : -0.5f);
+	}
+}
+
+/**
+ * @brief Convert floating point samples to 32 bits integers in plain C.
+ */
+static void
+audio_dsp_to_s32_c(int32_t *dst, const float *src, size_t len, float scale,
+    float max)
+{
+	size_t i;
+	float v;
+
+	for (i = 0; i < len; i++) {
+		v = src[i] * scale;
+		if (v >= max)
+			dst[i] = max;
+		else if (v <= -scale)
+			dst[i] = -scale;
+		else
+			dst[i] = v + (v >= 0.0f ? 0.5f : -0.5f);
+	}
+}
+
+/**
+ * @brief Convert a single channel of 32 bits fixed point samples to
+ *        floating point in plain C.
+ */
+static void
+audio_dsp_from_fixed_mono_c(float *dst, const int32_t *src, size_t len,
+    float scale)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = src[i] * scale;
+}
+
+/**
+ * @brief Convert and interleave two channels of 32 bits fixed point
+ *        samples to floating point in plain C.
+ */
+static void
+audio_dsp_from_fixed_stereo_c(float *dst, const int32_t *left,
+    const int32_t *right, size_t len, float scale)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		dst[2 * i] = left[i] * scale;
+		dst[2 * i + 1] = right[i] * scale;
+	}
+}
+
+/**
+ * @brief Compute the dot product of two vectors in plain C.
+ */
+static float
+audio_dsp_dot_c(const float *a, const float *b, size_t len)
+{
+	float sum = 0.0f;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		sum += a[i] * b[i];
+	return (sum);
+}
+
+/**
+ * @brief Apply a linearly changing gain in plain C.
+ */
+static void
+audio_dsp_gain_c(float *buf, size_t len, float gain, float step)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] *= gain + step * i;
+}
+
+/**
+ * @brief Mix two buffers with a linearly rising gain in plain C.
+ */
+static void
+audio_dsp_crossfade_c(float *dst, const float *src, size_t len,
+    unsigned long pos, float step)
+{
+	float gain;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		/* Computed from scratch to prevent accumulating errors */
+		gain = MIN((pos + i) * step, 1.0f);
+		dst[i] += (src[i] - dst[i]) * gain;
+	}
+}
+
+#ifdef DSP_SSE2
+/**
+ * @brief Convert 16 bits samples to floating point using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_from_s16_sse2(float *dst, const int16_t *src, size_t len)
+{
+	__m128i v;
+	__m128 scale;
+	size_t i;
+
+	scale = _mm_set1_ps(1.0f / DSP_S16_SCALE);
+	for (i = 0; i + 8 <= len; i += 8) {
+		v = _mm_loadu_si128((const __m128i *)(src + i));
+		/* Sign extend by shifting the samples into the top half */
+		_mm_storeu_ps(dst + i, _mm_mul_ps(scale, _mm_cvtepi32_ps(
+		    _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16))));
+		_mm_storeu_ps(dst + i + 4, _mm_mul_ps(scale, _mm_cvtepi32_ps(
+		    _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16))));
+	}
+	audio_dsp_from_s16_c(dst + i, src + i, len - i);
+}
+
+/**
+ * @brief Convert floating point samples to 16 bits using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_to_s16_sse2(int16_t *dst, const float *src, size_t len)
+{
+	__m128i lo, hi;
+	__m128 scale, min, max;
+	size_t i;
+
+	scale = _mm_set1_ps(DSP_S16_SCALE);
+	/* Clip before converting, as overflows yield INT_MIN */
+	min = _mm_set1_ps(-DSP_S16_SCALE);
+	max = _mm_set1_ps(DSP_S16_SCALE - 1.0f);
+	for (i = 0; i + 8 <= len; i += 8) {
+		lo = _mm_cvtps_epi32(_mm_max_ps(min, _mm_min_ps(max,
+		    _mm_mul_ps(scale, _mm_loadu_ps(src + i)))));
+		hi = _mm_cvtps_epi32(_mm_max_ps(min, _mm_min_ps(max,
+		    _mm_mul_ps(scale, _mm_loadu_ps(src + i + 4)))));
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	audio_dsp_to_s16_c(dst + i, src + i, len - i);
+}
+
+/**
+ * @brief Convert floating point samples to 32 bits integers using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_to_s32_sse2(int32_t *dst, const float *src, size_t len, float scale,
+    float max)
+{
+	__m128 vscale, vmin, vmax;
+	size_t i;
+
+	vscale = _mm_set1_ps(scale);
+	vmin = _mm_set1_ps(-scale);
+	vmax = _mm_set1_ps(max);
+	for (i = 0; i + 8 <= len; i += 8) {
+		_mm_storeu_si128((__m128i *)(dst + i), _mm_cvtps_epi32(
+		    _mm_max_ps(vmin, _mm_min_ps(vmax,
+		    _mm_mul_ps(vscale, _mm_loadu_ps(src + i))))));
+		_mm_storeu_si128((__m128i *)(dst + i + 4), _mm_cvtps_epi32(
+		    _mm_max_ps(vmin, _mm_min_ps(vmax,
+		    _mm_mul_ps(vscale, _mm_loadu_ps(src + i + 4))))));
+	}
+	audio_dsp_to_s32_c(dst + i, src + i, len - i, scale, max);
+}
+
+/**
+ * @brief Convert a single channel of 32 bits fixed point samples to
+ *        floating point using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_from_fixed_mono_sse2(float *dst, const int32_t *src, size_t len,
+    float scale)
+{
+	__m128 vscale;
+	size_t i;
+
+	vscale = _mm_set1_ps(scale);
+	for (i = 0; i + 4 <= len; i += 4)
+		_mm_storeu_ps(dst + i, _mm_mul_ps(vscale, _mm_cvtepi32_ps(
+		    _mm_loadu_si128((const __m128i *)(src + i)))));
+	audio_dsp_from_fixed_mono_c(dst + i, src + i, len - i, scale);
+}
+
+/**
+ * @brief Convert and interleave two channels of 32 bits fixed point
+ *        samples to floating point using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_from_fixed_stereo_sse2(float *dst, const int32_t *left,
+    const int32_t *right, size_t len, float scale)
+{
+	__m128 vscale, l, r;
+	size_t i;
+
+	vscale = _mm_set1_ps(scale);
+	for (i = 0; i + 4 <= len; i += 4) {
+		l = _mm_mul_ps(vscale, _mm_cvtepi32_ps(
+		    _mm_loadu_si128((const __m128i *)(left + i))));
+		r = _mm_mul_ps(vscale, _mm_cvtepi32_ps(
+		    _mm_loadu_si128((const __m128i *)(right + i))));
+		_mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+		_mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+	}
+	audio_dsp_from_fixed_stereo_c(dst + 2 * i, left + i, right + i,
+	    len - i, scale);
+}
+
+/**
+ * @brief Compute the dot product of two vectors using SSE2.
+ */
+__attribute__((target("sse2"))) static float
+audio_dsp_dot_sse2(const float *a, const float *b, size_t len)
+{
+	__m128 s0, s1;
+	float sum[4];
+	size_t i;
+
+	/* Two accumulators to hide the latency of the additions */
+	s0 = s1 = _mm_setzero_ps();
+	for (i = 0; i + 8 <= len; i += 8) {
+		s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_loadu_ps(a + i),
+		    _mm_loadu_ps(b + i)));
+		s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+		    _mm_loadu_ps(b + i + 4)));
+	}
+	_mm_storeu_ps(sum, _mm_add_ps(s0, s1));
+	return (sum[0] + sum[1] + sum[2] + sum[3] +
+	    audio_dsp_dot_c(a + i, b + i, len - i));
+}
+
+/**
+ * @brief Apply a linearly changing gain using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_gain_sse2(float *buf, size_t len, float gain, float step)
+{
+	__m128 g, inc;
+	size_t i;
+
+	g = _mm_add_ps(_mm_set1_ps(gain),
+	    _mm_mul_ps(_mm_set1_ps(step), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f)));
+	inc = _mm_set1_ps(step * 4.0f);
+	for (i = 0; i + 4 <= len; i += 4) {
+		_mm_storeu_ps(buf + i, _mm_mul_ps(_mm_loadu_ps(buf + i), g));
+		g = _mm_add_ps(g, inc);
+	}
+	audio_dsp_gain_c(buf + i, len - i, gain + step * i, step);
+}
+
+/**
+ * @brief Mix two buffers with a linearly rising gain using SSE2.
+ */
+__attribute__((target("sse2"))) static void
+audio_dsp_crossfade_sse2(float *dst, const float *src, size_t len,
+    unsigned long pos, float step)
+{
+	__m128 ramp, vstep, one, g, d;
+	size_t i;
+
+	ramp = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+	vstep = _mm_set1_ps(step);
+	one = _mm_set1_ps(1.0f);
+	for (i = 0; i + 4 <= len; i += 4) {
+		g = _mm_mul_ps(_mm_add_ps(_mm_set1_ps((float)(pos + i)), ramp),
+		    vstep);
+		g = _mm_min_ps(g, one);
+		d = _mm_loadu_ps(dst + i);
+		_mm_storeu_ps(dst + i, _mm_add_ps(d,
+		    _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(src + i), d), g)));
+	}
+	audio_dsp_crossfade_c(dst + i, src + i, len - i, pos + i, step);
+}
+#endif /* DSP_SSE2 */
+
+#ifdef __ARM_NEON
+/**
+ * @brief Convert 16 bits samples to floating point using NEON.
+ */
+static void
+audio_dsp_from_s16_neon(float *dst, const int16_t *src, size_t len)
+{
+	int16x8_t v;
+	size_t i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		v = vld1q_s16(src + i);
+		vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(
+		    vmovl_s16(vget_low_s16(v))), 1.0f / DSP_S16_SCALE));
+		vst1q_f32(dst + i + 4, vmulq_n_f32(vcvtq_f32_s32(
+		    vmovl_s16(vget_high_s16(v))), 1.0f / DSP_S16_SCALE));
+	}
+	audio_dsp_from_s16_c(dst + i, src + i, len - i);
+}
+
+/**
+ * @brief Round four floating point samples to integers.
+ */
+static inline int32x4_t
+audio_dsp_round_neon(float32x4_t v)
+{
+#ifdef __aarch64__
+	return (vcvtnq_s32_f32(v));
+#else /* !__aarch64__ */
+	uint32x4_t half;
+
+	/* Conversion truncates - add 0.5 with the sign of the sample */
+	half = vorrq_u32(vandq_u32(vreinterpretq_u32_f32(v),
+	    vdupq_n_u32(0x80000000)), vreinterpretq_u32_f32(vdupq_n_f32(0.5f)));
+	return (vcvtq_s32_f32(vaddq_f32(v, vreinterpretq_f32_u32(half))));
+#endif /* __aarch64__ */
+}
+
+/**
+ * @brief Convert floating point samples to 16 bits using NEON.
+ */
+static void
+audio_dsp_to_s16_neon(int16_t *dst, const float *src, size_t len)
+{
+	int32x4_t lo, hi;
+	size_t i;
+
+	for (i = 0; i + 8 <= len; i += 8) {
+		lo = audio_dsp_round_neon(
+		    vmulq_n_f32(vld1q_f32(src + i), DSP_S16_SCALE));
+		hi = audio_dsp_round_neon(
+		    vmulq_n_f32(vld1q_f32(src + i + 4), DSP_S16_SCALE));
+		/* Both conversions saturate */
+		vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+	audio_dsp_to_s16_c(dst + i, src + i, len - i);
+}
+
+/**
+ * @brief Convert floating point samples to 32 bits integers using NEON.
+ */
+static void
+audio_dsp_to_s32_neon(int32_t *dst, const float *src, size_t len, float scale,
+    float max)
+{
+	float32x4_t vmin, vmax;
+	size_t i;
+
+	vmin = vdupq_n_f32(-scale);
+	vmax = vdupq_n_f32(max);
+	for (i = 0; i + 8 <= len; i += 8) {
+		vst1q_s32(dst + i, audio_dsp_round_neon(vmaxq_f32(vmin,
+		    vminq_f32(vmax, vmulq_n_f32(vld1q_f32(src + i), scale)))));
+		vst1q_s32(dst + i + 4, audio_dsp_round_neon(vmaxq_f32(vmin,
+		    vminq_f32(vmax, vmulq_n_f32(vld1q_f32(src + i + 4), scale)))));
+	}
+	audio_dsp_to_s32_c(dst + i, src + i, len - i, scale, max);
+}
+
+/**
+ * @brief Convert a single channel of 32 bits fixed point samples to
+ *        floating point using NEON.
+ */
+static void
+audio_dsp_from_fixed_mono_neon(float *dst, const int32_t *src, size_t len,
+    float scale)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4)
+		vst1q_f32(dst + i,
+		    vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src + i)), scale));
+	audio_dsp_from_fixed_mono_c(dst + i, src + i, len - i, scale);
+}
+
+/**
+ * @brief Convert and interleave two channels of 32 bits fixed point
+ *        samples to floating point using NEON.
+ */
+static void
+audio_dsp_from_fixed_stereo_neon(float *dst, const int32_t *left,
+    const int32_t *right, size_t len, float scale)
+{
+	float32x4x2_t v;
+	size_t i;
+
+	for (i = 0; i + 4 <= len; i += 4) {
+		v.val[0] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(left + i)),
+		    scale);
+		v.val[1] = vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(right + i)),
+		    scale);
+		/* Stores the channels interleaved */
+		vst2q_f32(dst + 2 * i, v);
+	}
+	audio_dsp_from_fixed_stereo_c(dst + 2 * i, left + i, right + i,
+	    len - i, scale);
+}
+
+/**
+ * @brief Compute the dot product of two vectors using NEON.
+ */
+static float
+audio_dsp_dot_neon(const float *a, const float *b, size_t len)
+{
+	float32x4_t s0, s1;
+	float32x2_t sum;
+	size_t i;
+
+	s0 = s1 = vdupq_n_f32(0.0f);
+	for (i = 0; i + 8 <= len; i += 8) {
+		s0 = vmlaq_f32(s0, vld1q_f32(a + i), vld1q_f32(b + i));
+		s1 = vmlaq_f32(s1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+	}
+	s0 = vaddq_f32(s0, s1);
+	sum = vadd_f32(vget_low_f32(s0), vget_high_f32(s0));
+	return (vget_lane_f32(vpadd_f32(sum, sum), 0) +
+	    audio_dsp_dot_c(a + i, b + i, len - i));
+}
+
+/**
+ * @brief Apply a linearly changing gain using NEON.
+ */
+static void
+audio_dsp_gain_neon(float *buf, size_t len, float gain, float step)
+{
+	static const float ramp[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t g, inc;
+	size_t i;
+
+	g = vmlaq_n_f32(vdupq_n_f32(gain), vld1q_f32(ramp), step);
+	inc = vdupq_n_f32(step * 4.0f);
+	for (i = 0; i + 4 <= len; i += 4) {
+		vst1q_f32(buf + i, vmulq_f32(vld1q_f32(buf + i), g));
+		g = vaddq_f32(g, inc);
+	}
+	audio_dsp_gain_c(buf + i, len - i, gain + step * i, step);
+}
+
+/**
+ * @brief Mix two buffers with a linearly rising gain using NEON.
+ */
+static void
+audio_dsp_crossfade_neon(float *dst, const float *src, size_t len,
+    unsigned long pos, float step)
+{
+	static const float ramp[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	float32x4_t r, one, g, d;
+	size_t i;
+
+	r = vld1q_f32(ramp);
+	one = vdupq_n_f32(1.0f);
+	for (i = 0; i + 4 <= len; i += 4) {
+		g = vmulq_n_f32(vaddq_f32(vdupq_n_f32((float)(pos + i)), r),
+		    step);
+		g = vminq_f32(g, one);
+		d = vld1q_f32(dst + i);
+		vst1q_f32(dst + i, vmlaq_f32(d,
+		    vsubq_f32(vld1q_f32(src + i), d), g));
+	}
+	audio_dsp_crossfade_c(dst + i, src + i, len - i, pos + i, step);
+}
+#endif /* __ARM_NEON */
+
+/**
+ * @brief Routine used to convert 16 bits samples to floating point.
+ */
+static void (*audio_dsp_from_s16_func)(float *dst, const int16_t *src,
+    size_t len) = audio_dsp_from_s16_c;
+/**
+ * @brief Routine used to convert floating point samples to 16 bits.
+ */
+static void (*audio_dsp_to_s16_func)(int16_t *dst, const float *src,
+    size_t len) = audio_dsp_to_s16_c;
+/**
+ * @brief Routine used to convert floating point samples to 32 bits
+ *        integers.
+ */
+static void (*audio_dsp_to_s32_func)(int32_t *dst, const float *src,
+    size_t len, float scale, float max) = audio_dsp_to_s32_c;
+/**
+ * @brief Routine used to convert a single channel of fixed point
+ *        samples to floating point.
+ */
+static void (*audio_dsp_from_fixed_mono_func)(float *dst, const int32_t *src,
+    size_t len, float scale) = audio_dsp_from_fixed_mono_c;
+/**
+ * @brief Routine used to convert two channels of fixed point samples to
+ *        interleaved floating point.
+ */
+static void (*audio_dsp_from_fixed_stereo_func)(float *dst,
+    const int32_t *left, const int32_t *right, size_t len,
+    float scale) = audio_dsp_from_fixed_stereo_c;
+/**
+ * @brief Routine used to compute dot products.
+ */
+static float (*audio_dsp_dot_func)(const float *a, const float *b,
+    size_t len) = audio_dsp_dot_c;
+/**
+ * @brief Routine used to apply gain.
+ */
+static void (*audio_dsp_gain_func)(float *buf, size_t len, float gain,
+    float step) = audio_dsp_gain_c;
+/**
+ * @brief Routine used to crossfade between two buffers.
+ */
+static void (*audio_dsp_crossfade_func)(float *dst, const float *src,
+    size_t len, unsigned long pos, float step) = audio_dsp_crossfade_c;
+
+void
+audio_dsp_init(void)
+{
+#ifdef DSP_SSE2
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		audio_dsp_from_s16_func = audio_dsp_from_s16_sse2;
+		audio_dsp_to_s16_func = audio_dsp_to_s16_sse2;
+		audio_dsp_to_s32_func = audio_dsp_to_s32_sse2;
+		audio_dsp_from_fixed_mono_func =
+		    audio_dsp_from_fixed_mono_sse2;
+		audio_dsp_from_fixed_stereo_func =
+		    audio_dsp_from_fixed_stereo_sse2;
+		audio_dsp_dot_func = audio_dsp_dot_sse2;
+		audio_dsp_gain_func = audio_dsp_gain_sse2;
+		audio_dsp_crossfade_func = audio_dsp_crossfade_sse2;
+	}
+#endif /* DSP_SSE2 */
+#ifdef __ARM_NEON
+	/* Only defined when NEON is part of the target architecture */
+	audio_dsp_from_s16_func = audio_dsp_from_s16_neon;
+	audio_dsp_to_s16_func = audio_dsp_to_s16_neon;
+	audio_dsp_to_s32_func = audio_dsp_to_s32_neon;
+	audio_dsp_from_fixed_mono_func = audio_dsp_from_fixed_mono_neon;
+	audio_dsp_from_fixed_stereo_func = audio_dsp_from_fixed_stereo_neon;
+	audio_dsp_dot_func = audio_dsp_dot_neon;
+	audio_dsp_gain_func = audio_dsp_gain_neon;
+	audio_dsp_crossfade_func = audio_dsp_crossfade_neon;
+#endif /* __ARM_NEON */
+}
+
+void
+audio_dsp_from_s16(float *dst, const int16_t *src, size_t len)
+{
+	audio_dsp_from_s16_func(dst, src, len);
+}
+
+void
+audio_dsp_to_s16(int16_t *dst, const float *src, size_t len)
+{
+	audio_dsp_to_s16_func(dst, src, len);
+}
+
+void
+audio_dsp_to_s32(int32_t *dst, const float *src, size_t len,
+    unsigned int bits)
+{
+	float scale;
+
+	scale = (float)(1UL << (bits - 1));
+	/*
+	 * The largest 32 bits sample can't be represented as a float.
+	 * Clip to the largest float below it, as overflows yield
+	 * INT_MIN.
+	 */
+	audio_dsp_to_s32_func(dst, src, len, scale,
+	    MIN(scale - 1.0f, 2147483520.0f));
+}
+
+void
+audio_dsp_from_fixed(float *dst, const int32_t *left, const int32_t *right,
+    size_t len, unsigned int fracbits)
+{
+	float scale;
+
+	scale = 1.0f / (float)(1UL << fracbits);
+	if (right == NULL)
+		audio_dsp_from_fixed_mono_func(dst, left, len, scale);
+	else
+		audio_dsp_from_fixed_stereo_func(dst, left, right, len, scale);
+}
+
+float
+audio_dsp_dot(const float *a, const float *b, size_t len)
+{
+	return (audio_dsp_dot_func(a, b, len));
+}
+
+void
+audio_dsp_gain(float *buf, size_t len, float from, float to)
+{
+	audio_dsp_gain_func(buf, len, from, (to - from) / len);
+}
+
+void
+audio_dsp_remap(float *dst, unsigned int dchannels,
+    const float *src, unsigned int schannels, size_t frames)
+{
+	size_t i;
+	unsigned int c;
+	float sum, scale;
+
+	if (dchannels == schannels) {
+		memcpy(dst, src, frames * dchannels * sizeof(float));
+	} else if (schannels == 1) {
+		/* Copy mono audio to all channels */
+		for (i = 0; i < frames; i++)
+			for (c = 0; c < dchannels; c++)
+				*dst++ = src[i];
+	} else if (dchannels == 1) {
+		/*
+		 * Downmix all channels with equal weight. The order of the
+		 * channels depends on the audio format, so we can't tell
+		 * the centre and surround channels apart.
+		 */
+		scale = 1.0f / schannels;
+		for (i = 0; i < frames; i++, src += schannels) {
+			sum = src[0];
+			for (c = 1; c < schannels; c++)
+				sum += src[c];
+			dst[i] = sum * scale;
+		}
+	} else {
+		/* Keep the channels we have in common */
+		for (i = 0; i < frames; i++, src += schannels) {
+			for (c = 0; c < dchannels; c++)
+				*dst++ = c < schannels ? src[c] : 0.0f;
+		}
+	}
+}
+
+void
+audio_dsp_crossfade(float *dst, const float *src, size_t len,
+    unsigned long pos, unsigned long total)
+{
+	if (pos >= total) {
+		/* Fade has already been completed */
+		memcpy(dst, src, len * sizeof(float));
+		return;
+	}
+
+	audio_dsp_crossfade_func(dst, src, len, pos, 1.0f / total);
+}
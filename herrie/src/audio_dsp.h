@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_dsp.h
+ * @brief Sample processing routines used by the playback engine.
+ */
+
+/**
+ * @brief Select the conversion routines that match the features of the
+ *        CPU. Must be called before any audio is converted.
+ */
+void audio_dsp_init(void);
+/**
+ * @brief Convert 16 bits samples to floating point samples in the
+ *        range [-1.0, 1.0).
+ */
+void audio_dsp_from_s16(float *dst, const int16_t *src, size_t len);
+/**
+ * @brief Convert floating point samples to 16 bits samples, clipping
+ *        the samples that are out of range.
+ */
+void audio_dsp_to_s16(int16_t *dst, const float *src, size_t len);
+/**
+ * @brief Convert floating point samples to signed integers of the
+ *        given amount of bits, stored in the low bits of 32 bits
+ *        integers and clipping the samples that are out of range.
+ */
+void audio_dsp_to_s32(int32_t *dst, const float *src, size_t len,
+    unsigned int bits);
+/**
+ * @brief Convert len frames of one or two channels of fixed point
+ *        samples with fracbits fractional bits to interleaved floating
+ *        point samples. right is NULL for mono audio.
+ */
+void audio_dsp_from_fixed(float *dst, const int32_t *left,
+    const int32_t *right, size_t len, unsigned int fracbits);
+/**
+ * @brief Compute the dot product of two vectors of len floats.
+ */
+float audio_dsp_dot(const float *a, const float *b, size_t len);
+/**
+ * @brief Multiply len samples by a gain that changes linearly from
+ *        one value to another, to prevent zipper noise.
+ */
+void audio_dsp_gain(float *buf, size_t len, float from, float to);
+
+/**
+ * @brief Convert interleaved audio from one amount of channels to
+ *        another. Mono audio is copied to all channels and audio is
+ *        downmixed to mono by averaging all channels. Otherwise, the
+ *        leading channels are kept and missing ones are silent, as the
+ *        channel layout is not known.
+ */
+void audio_dsp_remap(float *dst, unsigned int dchannels,
+    const float *src, unsigned int schannels, size_t frames);
+/**
+ * @brief Mix len samples of src into dst, fading dst out and src in.
+ *        The gain of src rises linearly from pos / total to
+ *        (pos + len) / total.
+ */
+void audio_dsp_crossfade(float *dst, const float *src, size_t len,
+    unsigned long pos, unsigned long total);
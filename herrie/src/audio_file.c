@@ -51,11 +51,11 @@ struct audio_format {
 	/**
 	 * @brief The format's read call.
 	 */
-	size_t	(*read)(struct audio_file *fd, int16_t *buf, size_t len);
+	size_t	(*read)(struct audio_file *fd, float *buf, size_t len);
 	/**
-	 * @brief The format's seek call.
+	 * @brief The format's seek call. The position is in frames.
 	 */
-	void	(*seek)(struct audio_file *fd, int len, int rel);
+	void	(*seek)(struct audio_file *fd, int64_t frame);
 };
 
 /*
@@ -92,6 +92,19 @@ static struct audio_format formats[] = {
  */
 #define NUM_FORMATS (sizeof formats / sizeof(struct audio_format))
 
+/**
+ * @brief Derive the positions in seconds from the positions in frames.
+ */
+static void
+audio_file_update_time(struct audio_file *fd)
+{
+	if (fd->srate == 0)
+		return;
+
+	fd->time_cur = fd->frame_cur / fd->srate;
+	fd->time_len = fd->frame_len / fd->srate;
+}
+
 struct audio_file *
 audio_file_open(const struct vfsref *vr)
 {
@@ -100,6 +113,7 @@ audio_file_open(const struct vfsref *vr)
 	unsigned int i;
 
 	out = g_slice_new0(struct audio_file);
+	out->refcount = 1;
 
 	out->fp = vfs_open(vr);
 	if (out->fp == NULL)
@@ -129,6 +143,7 @@ audio_file_open(const struct vfsref *vr)
 	/* No tag - just use the display name then */
 	if (out->title == NULL)
 		out->title = g_strdup(vfs_name(vr));
+	audio_file_update_time(out);
 
 	return (out);
 
@@ -143,6 +158,23 @@ audio_file_close(struct audio_file *fd)
 	fd->drv->close(fd);
 	if (fd->fp != NULL)
 		fclose(fd->fp);
+	fd->fp = NULL;
+
+	audio_file_unref(fd);
+}
+
+struct audio_file *
+audio_file_ref(struct audio_file *fd)
+{
+	g_atomic_int_inc(&fd->refcount);
+	return (fd);
+}
+
+void
+audio_file_unref(struct audio_file *fd)
+{
+	if (!g_atomic_int_dec_and_test(&fd->refcount))
+		return;
 
 	g_free(fd->artist);
 	g_free(fd->title);
@@ -153,11 +185,12 @@ audio_file_close(struct audio_file *fd)
 }
 
 size_t
-audio_file_read(struct audio_file *fd, int16_t *buf, size_t len)
+audio_file_read(struct audio_file *fd, float *buf, size_t len)
 {
 	size_t ret;
 
 	ret = fd->drv->read(fd, buf, len);
+	audio_file_update_time(fd);
 #ifdef BUILD_SCROBBLER
 	scrobbler_notify_read(fd, (ret == 0));
 #endif /* BUILD_SCROBBLER */
@@ -166,12 +199,16 @@ audio_file_read(struct audio_file *fd, int16_t *buf, size_t len)
 }
 
 void
-audio_file_seek(struct audio_file *fd, int len, int rel)
+audio_file_seek(struct audio_file *fd, int64_t frame)
 {
-	g_assert(len != 0 || rel == 0);
-
 	if (!fd->stream) {
-		fd->drv->seek(fd, len, rel);
+		/* Don't seek out of reach */
+		frame = MAX(frame, 0);
+		if (fd->frame_len != 0)
+			frame = MIN(frame, fd->frame_len);
+
+		fd->drv->seek(fd, frame);
+		audio_file_update_time(fd);
 #ifdef BUILD_SCROBBLER
 		scrobbler_notify_seek(fd);
 #endif /* BUILD_SCROBBLER */
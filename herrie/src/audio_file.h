@@ -61,17 +61,45 @@ struct audio_file {
 	unsigned int channels;
 
 	/**
-	 * @brief The file's length in seconds.
+	 * @brief The file's length in frames, or 0 when unknown.
+	 */
+	int64_t frame_len;
+	/**
+	 * @brief Position we are at in the file in frames.
+	 */
+	int64_t frame_cur;
+	/**
+	 * @brief Position of the audio that is audible in frames,
+	 *        compensated for the delay of the sound device. Only
+	 *        accessed while holding the position lock of the
+	 *        playlist.
+	 */
+	int64_t frame_play;
+
+	/**
+	 * @brief The file's length in seconds, derived from frame_len.
 	 */
 	unsigned int time_len;
 	/**
-	 * @brief Position we are at in the file in seconds.
+	 * @brief Position we are at in the file in seconds, derived from
+	 *        frame_cur.
 	 */
 	unsigned int time_cur;
+	/**
+	 * @brief Position of the audio that is audible in seconds,
+	 *        derived from frame_play.
+	 */
+	unsigned int time_play;
 	/**
 	 * @brief File is a stream (no seeking).
 	 */
 	int stream;
+	/**
+	 * @brief Reference count of the structure. The audio output
+	 *        thread may still hold a reference after the decoder has
+	 *        closed the file.
+	 */
+	int refcount;
 
 	/**
 	 * @brief Name of the artist, stored in UTF-8.
@@ -101,16 +129,29 @@ struct audio_file {
  */
 struct audio_file *audio_file_open(const struct vfsref *vr);
 /**
- * @brief Clean up the given audio_file struct and close the file handle.
+ * @brief Close the file handle and the decoder and drop the reference
+ *        obtained through audio_file_open().
  */
 void audio_file_close(struct audio_file *fd);
+/**
+ * @brief Obtain an additional reference to the audio_file struct. The
+ *        song information remains accessible until it is released.
+ */
+struct audio_file *audio_file_ref(struct audio_file *fd);
+/**
+ * @brief Release a reference to the audio_file struct, deallocating
+ *        it when it was the last one.
+ */
+void audio_file_unref(struct audio_file *fd);
 
 /**
- * @brief Call the read function in the audio_file struct.
+ * @brief Call the read function in the audio_file struct. Samples are
+ *        stored as interleaved floating point numbers.
  */
-size_t audio_file_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t audio_file_read(struct audio_file *fd, float *buf, size_t len);
 
 /**
- * @brief Call the seek function in the audio_file struct.
+ * @brief Call the seek function in the audio_file struct, moving to
+ *        an absolute position in frames.
  */
-void audio_file_seek(struct audio_file *fd, int len, int rel);
+void audio_file_seek(struct audio_file *fd, int64_t frame);
@@ -42,11 +42,11 @@ void modplug_close(struct audio_file *fd);
 /**
  * @brief Read data from the modplug file and place it in buf.
  */
-size_t modplug_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t modplug_read(struct audio_file *fd, float *buf, size_t len);
 /**
- * @brief Seek the modplug file a relatime amount of seconds.
+ * @brief Seek the modplug file to an absolute position in frames.
  */
-void modplug_seek(struct audio_file *fd, int len, int rel);
+void modplug_seek(struct audio_file *fd, int64_t frame);
 #endif /* BUILD_MODPLUG */
 
 #ifdef BUILD_MP3
@@ -61,11 +61,11 @@ void mp3_close(struct audio_file *fd);
 /**
  * @brief Read data from the mp3 file and place it in buf.
  */
-size_t mp3_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t mp3_read(struct audio_file *fd, float *buf, size_t len);
 /**
- * @brief Seek the mp3 file a relatime amount of seconds.
+ * @brief Seek the mp3 file to an absolute position in frames.
  */
-void mp3_seek(struct audio_file *fd, int len, int rel);
+void mp3_seek(struct audio_file *fd, int64_t frame);
 #endif /* BUILD_MP3 */
 
 #ifdef BUILD_GST
@@ -80,11 +80,11 @@ void gst_close(struct audio_file *fd);
 /**
  * @brief Read data from the GST file and place it in buf.
  */
-size_t gst_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t gst_read(struct audio_file *fd, float *buf, size_t len);
 /**
- * @brief Seek the GST file a relatime amount of seconds.
+ * @brief Seek the GST file to an absolute position in frames.
  */
-void gst_seek(struct audio_file *fd, int len, int rel);
+void gst_seek(struct audio_file *fd, int64_t frame);
 #endif /* BUILD_GST */
 
 #ifdef BUILD_SNDFILE
@@ -99,11 +99,12 @@ void sndfile_close(struct audio_file *fd);
 /**
  * @brief Read data from the soundfile and place it in buf.
  */
-size_t sndfile_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t sndfile_read(struct audio_file *fd, float *buf, size_t len);
 /**
- * @brief Seek a relative amount in seconds in the current file handle.
+ * @brief Seek to an absolute position in frames in the current file
+ *        handle.
  */
-void sndfile_seek(struct audio_file *fd, int len, int rel);
+void sndfile_seek(struct audio_file *fd, int64_t frame);
 #endif /* BUILD_SNDFILE */
 
 #ifdef BUILD_VORBIS
@@ -118,9 +119,10 @@ void vorbis_close(struct audio_file *fd);
 /**
  * @brief Read data from the Ogg Vorbis file and place it in buf.
  */
-size_t vorbis_read(struct audio_file *fd, int16_t *buf, size_t len);
+size_t vorbis_read(struct audio_file *fd, float *buf, size_t len);
 /**
- * @brief Seek a relative amount in seconds in the current file handle.
+ * @brief Seek to an absolute position in frames in the current file
+ *        handle.
  */
-void vorbis_seek(struct audio_file *fd, int len, int rel);
+void vorbis_seek(struct audio_file *fd, int64_t frame);
 #endif /* BUILD_VORBIS */
@@ -71,8 +71,30 @@ struct gst_drv_data {
 	 * @brief The offset in the current buffer
 	 */
 	size_t gbuf_o;
+
+	/*
+	 * @brief Position of the first frame in the current buffer
+	 */
+	int64_t gbuf_frame;
+
+	/*
+	 * @brief Duration of the stream in nanoseconds
+	 */
+	GstClockTime duration;
 };
 
+/**
+ * @brief Convert the duration to a length in frames, once both the
+ *        duration and the sample rate are known
+ */
+static void
+gst_update_length(struct audio_file *fd, struct gst_drv_data *data)
+{
+	if (data->duration != GST_CLOCK_TIME_NONE && fd->srate != 0)
+		fd->frame_len = gst_util_uint64_scale(data->duration,
+		    fd->srate, GST_SECOND);
+}
+
 /**
  * @brief Pulls a buffer from the pipeline and store it in the drv_data
  *
@@ -99,7 +121,7 @@ gst_pull_buffer(struct audio_file *fd, struct gst_drv_data *data)
 		g_assert_not_reached();
 	}
 
-	g_assert(gbuf->size % sizeof(int16_t) == 0);
+	g_assert(gbuf->size % sizeof(float) == 0);
 
 	/* get the format of the buffer */
 	g_assert(gst_caps_get_size(gbuf->caps) == 1);
@@ -118,7 +140,12 @@ gst_pull_buffer(struct audio_file *fd, struct gst_drv_data *data)
 
 	/* Check for a timestamp */
 	if (gbuf->timestamp != GST_CLOCK_TIME_NONE)
-		fd->time_cur = gbuf->timestamp / 1000000000;
+		data->gbuf_frame = gst_util_uint64_scale(gbuf->timestamp,
+		    srate, GST_SECOND);
+	else
+		data->gbuf_frame = fd->frame_cur;
+	fd->frame_cur = data->gbuf_frame;
+	gst_update_length(fd, data);
 
 	return (0);
 }
@@ -147,6 +174,7 @@ static gboolean
 on_bus_tag(GstBus* bus, GstMessage* msg, void* user_data)
 {
 	struct audio_file* fd = user_data;
+	struct gst_drv_data *data = fd->drv_data;
 	GstTagList* tags;
 	char* artist = NULL;
 	char* title = NULL;
@@ -177,8 +205,10 @@ on_bus_tag(GstBus* bus, GstMessage* msg, void* user_data)
 
 	/* Set duration from tags, if not set already */
 	if (gst_tag_list_get_uint64(tags, GST_TAG_DURATION, &duration)) {
-		if (fd->time_len == 0)
-			fd->time_len = duration / 1000000000;
+		if (data->duration == GST_CLOCK_TIME_NONE) {
+			data->duration = duration;
+			gst_update_length(fd, data);
+		}
 	}
 
 	gst_tag_list_free(tags);
@@ -215,7 +245,8 @@ on_bus_duration(GstBus* bus, GstMessage* msg, void* user_data)
 			return TRUE;
 	}
 
-	fd->time_len = duration / 1000000000;
+	data->duration = duration;
+	gst_update_length(fd, data);
 
 	return TRUE;
 }
@@ -240,12 +271,11 @@ gst_open(struct audio_file *fd, const char *ext)
 			"fdsrc fd=%d ! "        /* read from the fd */
 			"decodebin ! "          /* decode it */
 			"audioconvert ! "       /* and  convert to: */
-			"audio/x-raw-int,"      /* raw pcm */
-			"width=16,depth=16,"    /* 16 bit amplitude */
-			"signed=True,"          /* signed integers */
-			"endianness=1234 ! "    /* in the right endianness */
+			"audio/x-raw-float,"    /* raw pcm */
+			"width=32,"             /* single precision */
+			"endianness=%d ! "      /* in the right endianness */
 			"appsink name=sink sync=False",
-				fileno(fd->fp));
+				fileno(fd->fp), G_BYTE_ORDER);
 	pipeline = gst_parse_launch(pipeline_desc->str, &err);
 	g_string_free(pipeline_desc, TRUE);
 	if (err) {
@@ -272,6 +302,8 @@ gst_open(struct audio_file *fd, const char *ext)
 	data->appsink = appsink;
 	data->gbuf = NULL;
 	data->gbuf_o = 0;
+	data->gbuf_frame = 0;
+	data->duration = GST_CLOCK_TIME_NONE;
 
 	/* Set up a message watch on the bus of the pipeline
 	 * (for tags, duration etc) */
@@ -348,7 +380,7 @@ gst_close(struct audio_file *fd)
 }
 
 size_t
-gst_read(struct audio_file *fd, int16_t *buf, size_t len)
+gst_read(struct audio_file *fd, float *buf, size_t len)
 {
 	struct gst_drv_data *data = fd->drv_data;
 	size_t written = 0;
@@ -361,17 +393,18 @@ gst_read(struct audio_file *fd, int16_t *buf, size_t len)
 				return 0;
 		}
 
-		to_copy = MIN(len - written, data->gbuf->size / sizeof(int16_t)
+		to_copy = MIN(len - written, data->gbuf->size / sizeof(float)
 						- data->gbuf_o);
 
 		memcpy(&(buf[written]),
-		       &(((int16_t*)data->gbuf->data)[data->gbuf_o]),
-		       to_copy * sizeof(int16_t));
+		       &(((float*)data->gbuf->data)[data->gbuf_o]),
+		       to_copy * sizeof(float));
 		written += to_copy;
 		data->gbuf_o += to_copy;
+		fd->frame_cur = data->gbuf_frame + data->gbuf_o / fd->channels;
 
 		/* Is the gbuf depleted? */
-		if (data->gbuf->size / sizeof(int16_t)
+		if (data->gbuf->size / sizeof(float)
 					== data->gbuf_o) {
 			gst_buffer_unref(data->gbuf);
 			data->gbuf = NULL;
@@ -382,20 +415,21 @@ gst_read(struct audio_file *fd, int16_t *buf, size_t len)
 }
 
 void
-gst_seek(struct audio_file *fd, int len, int rel)
+gst_seek(struct audio_file *fd, int64_t frame)
 {
 	struct gst_drv_data *data = fd->drv_data;
 
-	if (rel) {
-		/* Relative seek */
-		len += fd->time_cur;
-	}
-
-	/* Calculate the new relative position */
-	len = CLAMP(len, 0, (int)fd->time_len);
-
+	/* Don't let the accurate seek be rounded to a key unit */
 	gst_element_seek_simple(data->pipeline,
 				GST_FORMAT_TIME,
-				GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT,
-				((gint64)len) * 1000000000);
+				GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+				gst_util_uint64_scale(frame, GST_SECOND,
+				    fd->srate));
+
+	/* Throw away the buffer from before the seek */
+	if (data->gbuf) {
+		gst_buffer_unref(data->gbuf);
+		data->gbuf = NULL;
+	}
+	fd->frame_cur = frame;
 }
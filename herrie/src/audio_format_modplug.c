@@ -33,6 +33,7 @@
 #include <sys/mman.h>
 #include <modplug.h>
 
+#include "audio_dsp.h"
 #include "audio_file.h"
 #include "audio_format.h"
 #include "audio_output.h"
@@ -123,7 +124,8 @@ modplug_open(struct audio_file *fd, const char *ext)
 		fd->srate = SAMPLERATE;
 		fd->channels = 2;
 
-		fd->time_len = ModPlug_GetLength(data->modplug) / 1000;
+		fd->frame_len = (int64_t)ModPlug_GetLength(data->modplug) *
+		    SAMPLERATE / 1000;
 		title = ModPlug_GetName(data->modplug);
 		if (title != NULL && title[0] != '\0')
 			fd->title = g_strdup(title);
@@ -146,31 +148,45 @@ modplug_close(struct audio_file *fd)
 }
 
 size_t
-modplug_read(struct audio_file *fd, int16_t *buf, size_t len)
+modplug_read(struct audio_file *fd, float *buf, size_t len)
 {
 	struct modplug_drv_data *data = fd->drv_data;
+	int16_t tmp[4096];
+	size_t ret = 0;
 	int rlen;
 
-	rlen = ModPlug_Read(data->modplug, buf, len * sizeof(int16_t));
-	data->sample += rlen / BYTESPERSAMPLE;
-	fd->time_cur = data->sample / SAMPLERATE;
+	/* libmodplug only renders 16 bits samples */
+	while (ret < len) {
+		rlen = ModPlug_Read(data->modplug, tmp,
+		    MIN(len - ret, G_N_ELEMENTS(tmp)) * sizeof(int16_t));
+		if (rlen <= 0)
+			break;
+		rlen /= sizeof(int16_t);
+		audio_dsp_from_s16(buf + ret, tmp, rlen);
+		ret += rlen;
+	}
+	data->sample += ret * sizeof(int16_t) / BYTESPERSAMPLE;
+	fd->frame_cur = data->sample;
 
-	return (rlen / sizeof(int16_t));
+	return (ret);
 }
 
 void
-modplug_seek(struct audio_file *fd, int len, int rel)
+modplug_seek(struct audio_file *fd, int64_t frame)
 {
 	struct modplug_drv_data *data = fd->drv_data;
-	size_t off;
+	int16_t buf[(SAMPLERATE / 1000 + 1) * 2];
+	int ms;
 
-	off = len * SAMPLERATE;
-	if (rel)
-		off += data->sample;
 	/* Don't seek out of reach */
-	off = CLAMP(off, 0, (fd->time_len - 1) * SAMPLERATE);
-
-	ModPlug_Seek(data->modplug, (off * 10) / (SAMPLERATE / 100));
-	data->sample = off;
-	fd->time_cur = data->sample / SAMPLERATE;
+	frame = MIN(frame, MAX(fd->frame_len - SAMPLERATE, 0));
+
+	/* libmodplug seeks in milliseconds - decode the remainder */
+	ms = frame * 1000 / SAMPLERATE;
+	ModPlug_Seek(data->modplug, ms);
+	data->sample = (int64_t)ms * SAMPLERATE / 1000;
+	if (frame > data->sample)
+		data->sample += ModPlug_Read(data->modplug, buf,
+		    (frame - data->sample) * BYTESPERSAMPLE) / BYTESPERSAMPLE;
+	fd->frame_cur = data->sample;
 }
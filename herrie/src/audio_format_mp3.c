@@ -30,9 +30,11 @@
 
 #include "stdinc.h"
 
+#include <sys/mman.h>
 #include <mad.h>
 #include <id3tag.h>
 
+#include "audio_dsp.h"
 #include "audio_file.h"
 #include "audio_format.h"
 #include "audio_output.h"
@@ -58,28 +60,173 @@ struct mp3_drv_data {
 	 */
 	struct mad_synth	msynth;
 	/**
-	 * @brief Progress timer.
+	 * @brief Position of the first frame of audio of the current MP3
+	 *        frame.
 	 */
-	mad_timer_t		mtimer;
+	int64_t			framestart;
+	/**
+	 * @brief Amount of frames of audio in the current MP3 frame.
+	 */
+	unsigned int		framelen;
 	/**
 	 * @brief Sample offset.
 	 */
 	int			cursample;
 	/**
-	 * @brief Length of the file.
+	 * @brief Amount of samples that should be skipped in the next
+	 *        synthesized frame, used for sample accurate seeking.
+	 */
+	int			skipsample;
+	/**
+	 * @brief The header of the next frame has already been decoded.
 	 */
-	off_t			flen;
+	int			pending;
+	/**
+	 * @brief Offset of the first MP3 frame containing audio, past the
+	 *        ID3v2 tag and the Xing or VBRI frame.
+	 */
+	off_t			datastart;
+	/**
+	 * @brief Amount of frames of audio at the start of the stream
+	 *        that are discarded: the encoder and decoder delay.
+	 */
+	unsigned int		delay;
+	/**
+	 * @brief The exact length is known, so the padding at the end of
+	 *        the stream is discarded as well.
+	 */
+	int			gapless;
+	/**
+	 * @brief Amount of MP3 frames in the file, according to the Xing
+	 *        or VBRI frame.
+	 */
+	unsigned long		nframes;
+	/**
+	 * @brief Amount of frames of audio in a single MP3 frame.
+	 */
+	unsigned int		spf;
+	/**
+	 * @brief Whether the seek table is available.
+	 */
+	int			hastoc;
+	/**
+	 * @brief Seek table, containing the file offsets of the MP3
+	 *        frames at every percent of the song.
+	 */
+	off_t			toc[100];
 
 	/**
-	 * @brief Read buffer.
+	 * @brief Thread building the frame index in the background.
+	 */
+	GThread			*idxthread;
+	/**
+	 * @brief Descriptor of the file, read with pread() by the index
+	 *        thread when the file isn't memory mapped.
+	 */
+	int			idxfd;
+	/**
+	 * @brief Tell the index thread to stop. Should only be used with
+	 *        g_atomic_* operations.
 	 */
-	unsigned char buf_input[65536];
+	int			idxstop;
+	/**
+	 * @brief File offsets of every MP3_INDEX_FRAMES'th MP3 frame,
+	 *        counting from datastart. Filled while calculating the
+	 *        length when the file has no Xing or VBRI frame, or by the
+	 *        index thread otherwise.
+	 */
+	off_t			*idx;
+	/**
+	 * @brief Amount of entries allocated for the frame index.
+	 */
+	unsigned int		idxsize;
+	/**
+	 * @brief Amount of entries of the frame index that have been
+	 *        filled. Should only be used with g_atomic_* operations.
+	 */
+	int			idxlen;
+
+	/**
+	 * @brief Memory map of the entire file, or NULL when the file is
+	 *        read through the read buffer.
+	 */
+	unsigned char		*map;
+	/**
+	 * @brief Length of the memory map.
+	 */
+	size_t			maplen;
+	/**
+	 * @brief Offset in the memory map where decoding continues when
+	 *        the stream is reinitialized.
+	 */
+	off_t			mappos;
+	/**
+	 * @brief Offset in the file of the buffer handed to libmad.
+	 */
+	off_t			bufoff;
+	/**
+	 * @brief Read buffer. When the file is memory mapped, it only holds
+	 *        the last partial frame of the file.
+	 */
+	unsigned char		*buf_input;
 };
 
+/**
+ * @brief Size of the read buffer used when the file isn't memory
+ *        mapped.
+ */
+#define MP3_BUFLEN		65536
+/**
+ * @brief Size of the buffer holding the end of a memory mapped file,
+ *        which is large enough for a couple of frames.
+ */
+#define MP3_TAIL_LEN		8192
+/**
+ * @brief Largest ID3v2 text frame that is read.
+ */
+#define MP3_ID3_MAXFRAME	65536
+/**
+ * @brief Largest unsynchronised ID3v2.3 tag that is read into memory.
+ *        Larger ones are left to libid3tag.
+ */
+#define MP3_ID3_MAXTAG		(1024 * 1024)
+/**
+ * @brief Amount of frames preceding the seek position that are decoded
+ *        to fill up the bit reservoir.
+ */
+#define MP3_RESERVOIR_FRAMES	8
+
+/**
+ * @brief Decoder delay of libmad, which is added to the encoder delay
+ *        stored in the LAME tag.
+ */
+#define MP3_DECODER_DELAY	529
+/**
+ * @brief Amount of MP3 frames between entries of the frame index.
+ */
+#define MP3_INDEX_FRAMES	16
+/**
+ * @brief Size of the read buffer of the index thread.
+ */
+#define MP3_INDEX_BUFLEN	65536
+
 /*
  * File and tag matching
  */
 
+/**
+ * @brief Read a big endian number of len bytes.
+ */
+static inline uint32_t
+mp3_get_be(const unsigned char *p, unsigned int len)
+{
+	uint32_t ret = 0;
+
+	while (len-- > 0)
+		ret = (ret << 8) | *p++;
+	return (ret);
+}
+
 /**
  * @brief Test if an opened file is an MP3 file.
  */
@@ -113,10 +260,10 @@ done:	rewind(fp);
 }
 
 /**
- * @brief Read the ID3 tag from an MP3 file.
+ * @brief Read the ID3 tag from an MP3 file using libid3tag.
  */
 static void
-mp3_readtags(struct audio_file *fd)
+mp3_readtags_libid3tag(struct audio_file *fd)
 {
 	int tmpfd;
 	unsigned int i;
@@ -169,20 +316,375 @@ bad:
 	close(tmpfd);
 }
 
+/**
+ * @brief Source of the ID3v2 tag, which is either read from the file
+ *        or from memory.
+ */
+struct mp3_id3_src {
+	/**
+	 * @brief Descriptor of the file.
+	 */
+	int			fd;
+	/**
+	 * @brief Copy of the tag in memory, or NULL to read from the file.
+	 */
+	const unsigned char	*mem;
+	/**
+	 * @brief Length of the copy of the tag.
+	 */
+	size_t			len;
+};
+
+/**
+ * @brief Read len bytes of the ID3v2 tag at an offset from the start
+ *        of the file.
+ */
+static int
+mp3_id3_get(const struct mp3_id3_src *src, off_t off, unsigned char *buf,
+    size_t len)
+{
+	if (src->mem == NULL)
+		return (pread(src->fd, buf, len, off) == (ssize_t)len ? 0 : -1);
+
+	if ((size_t)off > src->len || len > src->len - off)
+		return (-1);
+	memcpy(buf, src->mem + off, len);
+	return (0);
+}
+
+/**
+ * @brief Read a synchsafe integer, storing seven bits in every byte.
+ */
+static inline uint32_t
+mp3_id3_synchsafe(const unsigned char *p)
+{
+	return ((p[0] << 21) | (p[1] << 14) | (p[2] << 7) | p[3]);
+}
+
+/**
+ * @brief Undo the unsynchronisation scheme, which inserts a null byte
+ *        after every 0xff byte. Returns the new length.
+ */
+static size_t
+mp3_id3_unsync(unsigned char *buf, size_t len)
+{
+	size_t i, j;
+
+	for (i = j = 0; i < len; i++) {
+		buf[j++] = buf[i];
+		if (buf[i] == 0xff && i + 1 < len && buf[i + 1] == 0x00)
+			i++;
+	}
+	return (j);
+}
+
+/**
+ * @brief Convert the first string of an ID3v2 text frame to UTF-8.
+ */
+static char *
+mp3_id3_text(const unsigned char *buf, size_t len)
+{
+	static const char *charsets[] =
+	    { "ISO-8859-1", "UTF-16", "UTF-16BE", "UTF-8" };
+	size_t n, width;
+
+	if (len < 1 || buf[0] >= G_N_ELEMENTS(charsets))
+		return (NULL);
+	width = (buf[0] == 1 || buf[0] == 2) ? 2 : 1;
+
+	/* Strings are terminated or separated by null characters */
+	for (n = 1; n + width <= len; n += width)
+		if (buf[n] == 0 && buf[n + width - 1] == 0)
+			break;
+	if (n == 1)
+		return (NULL);
+
+	return (g_convert((const char *)buf + 1, n - 1, "UTF-8",
+	    charsets[buf[0]], NULL, NULL, NULL));
+}
+
+/**
+ * @brief Determine which song information an ID3v2 frame contains.
+ */
+static char **
+mp3_id3_field(struct audio_file *fd, const unsigned char *id,
+    unsigned int version)
+{
+	if (version == 2) {
+		/* ID3v2.2 uses three character identifiers */
+		if (memcmp(id, "TP1", 3) == 0)
+			return (&fd->artist);
+		if (memcmp(id, "TT2", 3) == 0)
+			return (&fd->title);
+#ifdef BUILD_SCROBBLER
+		if (memcmp(id, "TAL", 3) == 0)
+			return (&fd->album);
+#endif /* BUILD_SCROBBLER */
+	} else {
+		if (memcmp(id, "TPE1", 4) == 0)
+			return (&fd->artist);
+		if (memcmp(id, "TIT2", 4) == 0)
+			return (&fd->title);
+#ifdef BUILD_SCROBBLER
+		if (memcmp(id, "TALB", 4) == 0)
+			return (&fd->album);
+#endif /* BUILD_SCROBBLER */
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Walk through the frames of an ID3v2 tag, only reading the
+ *        contents of the frames we're interested in. Returns -1 when
+ *        the tag uses features that are left to libid3tag.
+ */
+static int
+mp3_id3_frames(struct audio_file *fd, const struct mp3_id3_src *src,
+    unsigned int version, int unsync, off_t pos, off_t end)
+{
+	unsigned char fh[10], *buf;
+	unsigned int hlen, flags;
+	size_t flen, skip;
+	char **dst;
+
+	hlen = version == 2 ? 6 : 10;
+	while (pos + hlen <= end) {
+		if (mp3_id3_get(src, pos, fh, hlen) != 0)
+			return (-1);
+		/* Padding */
+		if (fh[0] == '\0')
+			break;
+
+		if (version == 2) {
+			flen = mp3_get_be(fh + 3, 3);
+			flags = 0;
+		} else if (version == 3) {
+			flen = mp3_get_be(fh + 4, 4);
+			flags = mp3_get_be(fh + 8, 2);
+		} else {
+			if ((fh[4] | fh[5] | fh[6] | fh[7]) & 0x80)
+				return (-1);
+			flen = mp3_id3_synchsafe(fh + 4);
+			flags = mp3_get_be(fh + 8, 2);
+		}
+		pos += hlen;
+		if ((off_t)flen > end - pos)
+			return (-1);
+
+		dst = mp3_id3_field(fd, fh, version);
+		if (dst == NULL || *dst != NULL || flen > MP3_ID3_MAXFRAME) {
+			pos += flen;
+			continue;
+		}
+
+		/* Compressed or encrypted frames */
+		if ((version == 3 && (flags & 0x00c0)) ||
+		    (version == 4 && (flags & 0x000c)))
+			return (-1);
+		/* Grouping identity and data length indicator */
+		skip = 0;
+		if (version == 3 && (flags & 0x0020))
+			skip = 1;
+		if (version == 4 && (flags & 0x0040))
+			skip++;
+		if (version == 4 && (flags & 0x0001))
+			skip += 4;
+
+		buf = g_malloc(flen);
+		if (mp3_id3_get(src, pos, buf, flen) != 0) {
+			g_free(buf);
+			return (-1);
+		}
+		if (flen > skip) {
+			if (version == 4 && (unsync || (flags & 0x0002)))
+				*dst = mp3_id3_text(buf + skip,
+				    mp3_id3_unsync(buf + skip, flen - skip));
+			else
+				*dst = mp3_id3_text(buf + skip, flen - skip);
+		}
+		g_free(buf);
+		pos += flen;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Read the song information from the ID3v2 tag at the start of
+ *        the file. Returns -1 when libid3tag should be used instead.
+ */
+static int
+mp3_readtags_id3v2(struct audio_file *fd)
+{
+	struct mp3_id3_src src;
+	unsigned char hdr[10], ext[4];
+	unsigned char *mem;
+	unsigned int version;
+	off_t pos, end;
+	int ret;
+
+	src.fd = fileno(fd->fp);
+	src.mem = NULL;
+	if (mp3_id3_get(&src, 0, hdr, sizeof hdr) != 0 ||
+	    memcmp(hdr, "ID3", 3) != 0)
+		return (0);
+	version = hdr[3];
+	if (version < 2 || version > 4 ||
+	    ((hdr[6] | hdr[7] | hdr[8] | hdr[9]) & 0x80) != 0)
+		return (-1);
+	/* ID3v2.2 uses this flag for compression */
+	if (version == 2 && (hdr[5] & 0x40))
+		return (-1);
+
+	pos = sizeof hdr;
+	end = pos + mp3_id3_synchsafe(hdr + 6);
+
+	if (version == 3 && (hdr[5] & 0x80)) {
+		/* The entire tag is unsynchronised */
+		if (end > MP3_ID3_MAXTAG)
+			return (-1);
+		mem = g_malloc(end);
+		if (mp3_id3_get(&src, 0, mem, end) != 0) {
+			g_free(mem);
+			return (-1);
+		}
+		end = pos + mp3_id3_unsync(mem + pos, end - pos);
+		src.mem = mem;
+		src.len = end;
+	}
+
+	/* Skip the extended header */
+	ret = 0;
+	if (version >= 3 && (hdr[5] & 0x40)) {
+		if (mp3_id3_get(&src, pos, ext, sizeof ext) != 0)
+			ret = -1;
+		else if (version == 3)
+			pos += sizeof ext + mp3_get_be(ext, 4);
+		else
+			pos += mp3_id3_synchsafe(ext);
+	}
+
+	if (ret == 0)
+		ret = mp3_id3_frames(fd, &src, version,
+		    version == 4 && (hdr[5] & 0x80), pos, end);
+	g_free((unsigned char *)src.mem);
+	return (ret);
+}
+
+/**
+ * @brief Copy a field of an ID3v1 tag, stripping the padding.
+ */
+static char *
+mp3_id3v1_field(const unsigned char *buf, size_t len)
+{
+	char *str;
+
+	str = g_convert((const char *)buf, strnlen((const char *)buf, len),
+	    "UTF-8", "ISO-8859-1", NULL, NULL, NULL);
+	if (str != NULL && g_strchomp(str)[0] == '\0') {
+		g_free(str);
+		str = NULL;
+	}
+	return (str);
+}
+
+/**
+ * @brief Read the missing song information from the ID3v1 tag at the
+ *        end of the file.
+ */
+static void
+mp3_readtags_id3v1(struct audio_file *fd)
+{
+	unsigned char tag[128];
+	struct stat fs;
+
+	if (fstat(fileno(fd->fp), &fs) != 0 || fs.st_size < (off_t)sizeof tag ||
+	    pread(fileno(fd->fp), tag, sizeof tag, fs.st_size - sizeof tag) !=
+	    sizeof tag || memcmp(tag, "TAG", 3) != 0)
+		return;
+
+	if (fd->title == NULL)
+		fd->title = mp3_id3v1_field(tag + 3, 30);
+	if (fd->artist == NULL)
+		fd->artist = mp3_id3v1_field(tag + 33, 30);
+#ifdef BUILD_SCROBBLER
+	if (fd->album == NULL)
+		fd->album = mp3_id3v1_field(tag + 63, 30);
+#endif /* BUILD_SCROBBLER */
+}
+
+/**
+ * @brief Read the ID3 tag from an MP3 file. Only the frames containing
+ *        the song information are read, falling back to libid3tag for
+ *        unusual tags.
+ */
+static void
+mp3_readtags(struct audio_file *fd)
+{
+	if (mp3_readtags_id3v2(fd) != 0) {
+		mp3_readtags_libid3tag(fd);
+		return;
+	}
+
+	if (fd->artist == NULL || fd->title == NULL)
+		mp3_readtags_id3v1(fd);
+}
+
 /*
  * MP3 frame decoding routines
  */
 
+/**
+ * @brief Hand the memory mapped file to libmad. The last partial frame
+ *        is copied to the read buffer, followed by the guard bytes that
+ *        libmad needs to decode it.
+ */
+static int
+mp3_map_buffer(struct audio_file *fd)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	off_t start;
+	size_t len;
+
+	if (data->mstream.next_frame == NULL) {
+		/* Decode straight from the memory map */
+		if (data->mappos >= (off_t)data->maplen)
+			return (-1);
+		data->bufoff = data->mappos;
+		mad_stream_buffer(&data->mstream, data->map + data->mappos,
+		    data->maplen - data->mappos);
+		return (0);
+	}
+
+	/* The end of the file has been drained as well */
+	if (data->mstream.buffer == data->buf_input)
+		return (-1);
+
+	start = data->bufoff +
+	    (data->mstream.next_frame - data->mstream.buffer);
+	len = MIN(data->maplen - start, MP3_TAIL_LEN);
+	memcpy(data->buf_input, data->map + start, len);
+	memset(data->buf_input + len, 0, MAD_BUFFER_GUARD);
+	data->bufoff = start;
+	mad_stream_buffer(&data->mstream, data->buf_input,
+	    len + MAD_BUFFER_GUARD);
+	return (0);
+}
+
 /**
  * @brief Refill the databuffer when it's drained, copying the last
  *        partial frame to the beginning.
  */
-static size_t
+static int
 mp3_fill_buffer(struct audio_file *fd)
 {
 	struct mp3_drv_data *data = fd->drv_data;
 	size_t offset, filledlen, readlen;
 
+	if (data->map != NULL)
+		return (mp3_map_buffer(fd));
+
 	if (data->mstream.next_frame == NULL) {
 		/* Place contents at the beginning */
 		offset = 0;
@@ -195,12 +697,14 @@ mp3_fill_buffer(struct audio_file *fd)
 		memmove(data->buf_input, data->mstream.next_frame, offset);
 	}
 
-	readlen = sizeof data->buf_input - offset;
+	/* Leave room for the guard bytes */
+	readlen = MP3_BUFLEN - MAD_BUFFER_GUARD - offset;
+	data->bufoff = ftello(fd->fp) - offset;
 
 	filledlen = fread(data->buf_input + offset, 1, readlen, fd->fp);
 
 	if (filledlen <= 0)
-		return (0);
+		return (-1);
 
 	if (filledlen < readlen) {
 		/*
@@ -212,8 +716,25 @@ mp3_fill_buffer(struct audio_file *fd)
 		filledlen += MAD_BUFFER_GUARD;
 	}
 
-	/* Return the length of the entire buffer */
-	return (offset + filledlen);
+	mad_stream_buffer(&data->mstream, data->buf_input,
+	    offset + filledlen);
+	return (0);
+}
+
+/**
+ * @brief Move to an offset in the file, from where decoding continues
+ *        after the stream has been reinitialized.
+ */
+static int
+mp3_setpos(struct audio_file *fd, off_t off)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+
+	if (data->map == NULL)
+		return (fseeko(fd->fp, off, SEEK_SET));
+
+	data->mappos = off;
+	return (0);
 }
 
 /**
@@ -223,28 +744,22 @@ static int
 mp3_read_frame(struct audio_file *fd)
 {
 	struct mp3_drv_data *data = fd->drv_data;
-	size_t buflen;
 
 	/*  Get the next frame */
 	for (;;) {
 		/* We've run out of data. Read from file */
 		if ((data->mstream.buffer == NULL) ||
 		    (data->mstream.error == MAD_ERROR_BUFLEN)) {
-			if ((buflen = mp3_fill_buffer(fd)) == 0)
+			if (mp3_fill_buffer(fd) != 0)
 				/* Read error */
 				return (1);
-
-			/* Load it back in */
-			mad_stream_buffer(&data->mstream, data->buf_input,
-			    buflen);
 			data->mstream.error = MAD_ERROR_NONE;
 		}
 
 		if (mad_header_decode(&data->mheader, &data->mstream) == 0) {
-			/* Update the audio timer */
-			mad_timer_add(&data->mtimer,
-			    data->mframe.header.duration);
-			fd->time_cur = data->mtimer.seconds;
+			/* Update the position */
+			data->framestart += data->framelen;
+			data->framelen = 32 * MAD_NSBSAMPLES(&data->mheader);
 			data->mframe.header = data->mheader;
 			return (0);
 		}
@@ -258,20 +773,6 @@ mp3_read_frame(struct audio_file *fd)
 
 }
 
-/**
- * @brief Convert a fixed point sample to a short.
- */
-static inline int16_t
-mp3_fixed_to_short(mad_fixed_t fixed)
-{
-	if (fixed >= MAD_F_ONE)
-		return (SHRT_MAX);
-	else if (fixed <= -MAD_F_ONE)
-		return (-SHRT_MAX);
-
-	return (fixed >> (MAD_F_FRACBITS - 15));
-}
-
 /**
  * @brief Rewind the current audio file handle to the beginning.
  */
@@ -280,47 +781,425 @@ mp3_rewind(struct audio_file *fd)
 {
 	struct mp3_drv_data *data = fd->drv_data;
 
-	rewind(fd->fp);
+	/* Skip the tags in front of the audio */
+	mp3_setpos(fd, data->datastart);
 
+	/* Positions before the delay has passed are negative */
+	data->framestart = -(int64_t)data->delay;
+	data->framelen = 0;
 	data->cursample = 0;
-	fd->time_cur = 0;
+	data->skipsample = 0;
+	data->pending = 0;
+	fd->frame_cur = 0;
 
 	mad_stream_init(&data->mstream);
 	mad_frame_init(&data->mframe);
 	mad_header_init(&data->mheader);
 	mad_synth_init(&data->msynth);
-	mad_timer_reset(&data->mtimer);
 }
 
 /**
- * @brief Calculate the length of the current audio file.
+ * @brief Return the position of the next frame of audio that will be
+ *        returned by mp3_read().
  */
-static void
-mp3_calc_length(struct audio_file *fd)
+static inline int64_t
+mp3_tell(struct mp3_drv_data *data)
+{
+	if (data->pending)
+		return (data->framestart + data->skipsample);
+	if (data->cursample == 0)
+		return (data->framestart + data->framelen);
+	return (data->framestart + data->cursample);
+}
+
+/**
+ * @brief Determine the offset in the file of a position in the read
+ *        buffer.
+ */
+static off_t
+mp3_offset(struct audio_file *fd, const unsigned char *ptr)
 {
 	struct mp3_drv_data *data = fd->drv_data;
-	off_t curpos;
 
-	/* Go to the end of the file */
-	do {
-		if (mp3_read_frame(fd) != 0) {
-			/* Short track */
-			fd->time_len = data->mtimer.seconds;
-			data->flen = ftello(fd->fp);
-			goto done;
+	return (data->bufoff + (ptr - data->mstream.buffer));
+}
+
+/**
+ * @brief Return the length of the ID3v2 tag at the start of the file,
+ *        or zero when there is none.
+ */
+static off_t
+mp3_id3_len(struct audio_file *fd)
+{
+	unsigned char hdr[10];
+	off_t len;
+
+	rewind(fd->fp);
+	if (fread(hdr, sizeof hdr, 1, fd->fp) != 1 ||
+	    memcmp(hdr, "ID3", 3) != 0 ||
+	    ((hdr[6] | hdr[7] | hdr[8] | hdr[9]) & 0x80) != 0)
+		return (0);
+
+	/* Synchsafe integer, excluding the header and the footer */
+	len = (hdr[6] << 21) | (hdr[7] << 14) | (hdr[8] << 7) | hdr[9];
+	len += sizeof hdr;
+	if (hdr[5] & 0x10)
+		len += sizeof hdr;
+	return (len);
+}
+
+/**
+ * @brief Parse the Xing or Info frame written by VBR encoders and LAME,
+ *        containing the length of the song, a seek table and the
+ *        encoder delay and padding.
+ */
+static int
+mp3_read_xing(struct audio_file *fd, off_t off, off_t flen)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	const unsigned char *p, *end;
+	uint32_t flags, bytes;
+	unsigned int i, encdelay, encpad;
+
+	end = data->mstream.next_frame;
+	/* The tag is stored after the side information */
+	p = data->mstream.this_frame + 4;
+	if (data->mheader.flags & MAD_FLAG_PROTECTION)
+		p += 2;
+	if (data->mheader.flags & MAD_FLAG_LSF_EXT)
+		p += data->mheader.mode == MAD_MODE_SINGLE_CHANNEL ? 9 : 17;
+	else
+		p += data->mheader.mode == MAD_MODE_SINGLE_CHANNEL ? 17 : 32;
+
+	if (p + 8 > end ||
+	    (memcmp(p, "Xing", 4) != 0 && memcmp(p, "Info", 4) != 0))
+		return (-1);
+	flags = mp3_get_be(p + 4, 4);
+	p += 8;
+
+	/* Without the amount of frames there is nothing to gain */
+	if (!(flags & 0x1) || p + 4 > end)
+		return (-1);
+	data->nframes = mp3_get_be(p, 4);
+	p += 4;
+
+	bytes = flen > off ? flen - off : 0;
+	if (flags & 0x2) {
+		if (p + 4 > end)
+			return (0);
+		if (mp3_get_be(p, 4) != 0)
+			bytes = mp3_get_be(p, 4);
+		p += 4;
+	}
+	if (flags & 0x4) {
+		if (p + 100 > end)
+			return (0);
+		/* Offsets are stored in 1/256ths of the stream */
+		for (i = 0; i < 100; i++)
+			data->toc[i] = off + (off_t)p[i] * bytes / 256;
+		data->hastoc = bytes != 0;
+		p += 100;
+	}
+	if (flags & 0x8)
+		p += 4;
+
+	/* LAME tag containing the encoder delay and padding */
+	if (p + 24 > end || (memcmp(p, "LAME", 4) != 0 &&
+	    memcmp(p, "Lavf", 4) != 0 && memcmp(p, "Lavc", 4) != 0))
+		return (0);
+	encdelay = mp3_get_be(p + 21, 3) >> 12;
+	encpad = mp3_get_be(p + 21, 3) & 0xfff;
+	if ((uint64_t)encdelay + encpad >=
+	    (uint64_t)data->nframes * data->spf)
+		return (0);
+
+	data->delay = encdelay + MP3_DECODER_DELAY;
+	data->gapless = 1;
+	fd->frame_len = (int64_t)data->nframes * data->spf -
+	    encdelay - encpad;
+	return (0);
+}
+
+/**
+ * @brief Parse the VBRI frame written by the Fraunhofer encoder,
+ *        containing the length of the song and a seek table.
+ */
+static int
+mp3_read_vbri(struct audio_file *fd, off_t off)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	const unsigned char *p, *end;
+	unsigned int i, k, entries, scale, size, fpe;
+	off_t cur, seg;
+	unsigned long frame;
+
+	end = data->mstream.next_frame;
+	/* Always stored after 32 bytes of side information */
+	p = data->mstream.this_frame + 4 + 32;
+	if (p + 26 > end || memcmp(p, "VBRI", 4) != 0)
+		return (-1);
+
+	data->nframes = mp3_get_be(p + 14, 4);
+	entries = mp3_get_be(p + 18, 2);
+	scale = mp3_get_be(p + 20, 2);
+	size = mp3_get_be(p + 22, 2);
+	fpe = mp3_get_be(p + 24, 2);
+	p += 26;
+	if (entries == 0 || fpe == 0 || size == 0 || size > 4 ||
+	    p + entries * size > end)
+		return (0);
+
+	/*
+	 * The table contains the sizes of segments of fpe frames.
+	 * Interpolate them to obtain the offset of every percent.
+	 */
+	cur = off;
+	seg = mp3_get_be(p, size) * scale;
+	for (i = 0, k = 0; i < 100; i++) {
+		frame = (uint64_t)data->nframes * i / 100;
+		while (frame >= (unsigned long)(k + 1) * fpe &&
+		    k + 1 < entries) {
+			cur += seg;
+			k++;
+			seg = mp3_get_be(p + k * size, size) * scale;
 		}
-	} while (data->mtimer.seconds < 100);
+		data->toc[i] = cur +
+		    seg * MIN(frame - (unsigned long)k * fpe, fpe) / fpe;
+	}
+	data->hastoc = 1;
+	return (0);
+}
 
-	/* Extrapolate the time. Not really accurate, but good enough */
-	curpos = ftello(fd->fp);
-	fseek(fd->fp, 0, SEEK_END);
-	data->flen = ftello(fd->fp);
+/**
+ * @brief Calculate the length of the current audio file, using the
+ *        Xing or VBRI frame when available. Returns -1 when not a
+ *        single frame can be decoded.
+ */
+static int
+mp3_calc_length(struct audio_file *fd)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	struct stat fs;
+	off_t off;
+	unsigned int i;
 
-	fd->time_len = ((double)data->flen / curpos) *
-	    data->mtimer.seconds;
+	data->datastart = mp3_id3_len(fd);
+	mp3_rewind(fd);
+
+	if (mp3_read_frame(fd) != 0) {
+		mp3_rewind(fd);
+		return (-1);
+	}
+	fd->srate = data->mheader.samplerate;
+	fd->channels = MAD_NCHANNELS(&data->mheader);
+	data->spf = data->framelen;
+
+	off = mp3_offset(fd, data->mstream.this_frame);
+	if (fstat(fileno(fd->fp), &fs) != 0)
+		fs.st_size = 0;
+	if (mp3_read_xing(fd, off, fs.st_size) == 0 ||
+	    mp3_read_vbri(fd, off) == 0) {
+		if (!data->gapless)
+			fd->frame_len = (int64_t)data->nframes * data->spf;
+		/* The frame itself contains silence */
+		data->datastart = mp3_offset(fd, data->mstream.next_frame);
+		goto done;
+	}
+	data->hastoc = 0;
+
+	/*
+	 * No information available - walk through all frames, filling
+	 * the frame index along the way.
+	 */
+	data->idxsize = 256;
+	data->idx = g_new(off_t, data->idxsize);
+	data->idx[0] = off;
+	data->nframes = 1;
+	while (mp3_read_frame(fd) == 0) {
+		if (data->nframes % MP3_INDEX_FRAMES == 0) {
+			i = data->nframes / MP3_INDEX_FRAMES;
+			if (i == data->idxsize) {
+				data->idxsize *= 2;
+				data->idx = g_renew(off_t, data->idx,
+				    data->idxsize);
+			}
+			data->idx[i] = mp3_offset(fd, data->mstream.this_frame);
+		}
+		data->nframes++;
+	}
+	g_atomic_int_set(&data->idxlen,
+	    (data->nframes + MP3_INDEX_FRAMES - 1) / MP3_INDEX_FRAMES);
+	fd->frame_len = data->framestart + data->framelen;
 done:
 	/* Go back to the start */
 	mp3_rewind(fd);
+	return (0);
+}
+
+/**
+ * @brief Hand the next part of the file to the stream of the index
+ *        thread, keeping the partial frame at the end of the previous
+ *        part. Memory mapped files are walked in place, apart from the
+ *        last partial frame.
+ */
+static int
+mp3_index_fill(struct mp3_drv_data *data, struct mad_stream *stream,
+    unsigned char *buf, off_t *bufoff)
+{
+	size_t keep = 0, want;
+	ssize_t len;
+
+	if (stream->next_frame != NULL) {
+		keep = stream->bufend - stream->next_frame;
+		*bufoff += stream->next_frame - stream->buffer;
+	}
+
+	if (data->map != NULL) {
+		if (stream->next_frame == NULL) {
+			mad_stream_buffer(stream, data->map + *bufoff,
+			    data->maplen - *bufoff);
+			return (0);
+		}
+
+		/* The end of the file has been drained as well */
+		if (stream->buffer == buf)
+			return (-1);
+		keep = MIN(keep, MP3_TAIL_LEN);
+		memcpy(buf, stream->next_frame, keep);
+		memset(buf + keep, 0, MAD_BUFFER_GUARD);
+		mad_stream_buffer(stream, buf, keep + MAD_BUFFER_GUARD);
+		return (0);
+	}
+
+	if (keep != 0)
+		memmove(buf, stream->next_frame, keep);
+	want = MP3_INDEX_BUFLEN - MAD_BUFFER_GUARD - keep;
+	len = pread(data->idxfd, buf + keep, want, *bufoff + keep);
+	if (len <= 0)
+		return (-1);
+	if ((size_t)len < want) {
+		/* Allow the last frame to be decoded */
+		memset(buf + keep + len, 0, MAD_BUFFER_GUARD);
+		len += MAD_BUFFER_GUARD;
+	}
+	mad_stream_buffer(stream, buf, keep + len);
+	return (0);
+}
+
+/**
+ * @brief Walk through the frame headers of the file without decoding
+ *        them, storing the offsets of the frames in the frame index.
+ */
+static void *
+mp3_index_thread(void *arg)
+{
+	struct mp3_drv_data *data = arg;
+	struct mad_stream stream;
+	struct mad_header header;
+	unsigned char *buf;
+	unsigned long frame = 0;
+	off_t bufoff;
+
+	buf = g_malloc(data->map != NULL ?
+	    MP3_TAIL_LEN + MAD_BUFFER_GUARD : MP3_INDEX_BUFLEN);
+	mad_stream_init(&stream);
+	mad_header_init(&header);
+	bufoff = data->datastart;
+
+	while (!g_atomic_int_get(&data->idxstop)) {
+		if (stream.buffer == NULL || stream.error == MAD_ERROR_BUFLEN) {
+			if (mp3_index_fill(data, &stream, buf, &bufoff) != 0)
+				break;
+			stream.error = MAD_ERROR_NONE;
+		}
+
+		if (mad_header_decode(&header, &stream) == 0) {
+			if (frame % MP3_INDEX_FRAMES == 0) {
+				if (frame / MP3_INDEX_FRAMES >= data->idxsize)
+					break;
+				data->idx[frame / MP3_INDEX_FRAMES] =
+				    bufoff + (stream.this_frame - stream.buffer);
+				/* Publish the entry after it has been stored */
+				g_atomic_int_set(&data->idxlen,
+				    frame / MP3_INDEX_FRAMES + 1);
+			}
+			frame++;
+		} else if (!MAD_RECOVERABLE(stream.error) &&
+		    stream.error != MAD_ERROR_BUFLEN) {
+			break;
+		}
+	}
+
+	mad_header_finish(&header);
+	mad_stream_finish(&stream);
+	g_free(buf);
+	return (NULL);
+}
+
+/**
+ * @brief Start building the frame index in the background, unless it
+ *        has been built while calculating the length already.
+ */
+static void
+mp3_index_start(struct audio_file *fd)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+
+	if (data->nframes == 0 || data->idx != NULL)
+		return;
+
+	/* Leave some room for files containing more frames than stated */
+	data->idxsize = data->nframes / MP3_INDEX_FRAMES + 2;
+	data->idx = g_new(off_t, data->idxsize);
+	data->idxfd = fileno(fd->fp);
+	data->idxthread = g_thread_new("mp3index", mp3_index_thread, data);
+}
+
+/**
+ * @brief Continue decoding at a file offset, containing the MP3 frame
+ *        that starts at the given position.
+ */
+static void
+mp3_jump(struct audio_file *fd, off_t off, int64_t pos)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+
+	if (mp3_setpos(fd, off) != 0)
+		return;
+
+	/* Start with a clean decoder at the new offset */
+	mad_stream_finish(&data->mstream);
+	mad_stream_init(&data->mstream);
+	mad_frame_mute(&data->mframe);
+	mad_synth_mute(&data->msynth);
+	data->framestart = pos;
+	data->framelen = 0;
+}
+
+/**
+ * @brief Memory map the entire file, so libmad can decode it without
+ *        copying it into the read buffer first.
+ */
+static void
+mp3_map(struct audio_file *fd)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	struct stat fs;
+	void *map;
+
+	if (fstat(fileno(fd->fp), &fs) != 0 || fs.st_size <= 0 ||
+	    (uint64_t)fs.st_size > SIZE_MAX)
+		return;
+
+	map = mmap(NULL, fs.st_size, PROT_READ, MAP_PRIVATE,
+	    fileno(fd->fp), 0);
+	if (map == MAP_FAILED)
+		/* Fall back to reading the file */
+		return;
+	madvise(map, fs.st_size, MADV_SEQUENTIAL);
+
+	data->map = map;
+	data->maplen = fs.st_size;
 }
 
 /*
@@ -339,12 +1218,30 @@ mp3_open(struct audio_file *fd, const char *ext)
 		mp3_readtags(fd);
 	}
 
-	data = g_slice_new(struct mp3_drv_data);
+	data = g_slice_new0(struct mp3_drv_data);
 	fd->drv_data = (void *)data;
 
-	mp3_rewind(fd);
 	if (!fd->stream)
-		mp3_calc_length(fd);
+		mp3_map(fd);
+	data->buf_input = g_malloc(data->map != NULL ?
+	    MP3_TAIL_LEN + MAD_BUFFER_GUARD : MP3_BUFLEN);
+
+	mp3_rewind(fd);
+	if (!fd->stream) {
+		if (mp3_calc_length(fd) != 0) {
+			/* Not a single frame could be decoded */
+			mad_frame_finish(&data->mframe);
+			mad_stream_finish(&data->mstream);
+			mad_synth_finish(&data->msynth);
+			if (data->map != NULL)
+				munmap(data->map, data->maplen);
+			g_free(data->buf_input);
+			g_slice_free(struct mp3_drv_data, data);
+			fd->drv_data = NULL;
+			return (-1);
+		}
+		mp3_index_start(fd);
+	}
 
 	return (0);
 }
@@ -354,45 +1251,82 @@ mp3_close(struct audio_file *fd)
 {
 	struct mp3_drv_data *data = fd->drv_data;
 
+	if (data->idxthread != NULL) {
+		g_atomic_int_set(&data->idxstop, 1);
+		g_thread_join(data->idxthread);
+	}
+	g_free(data->idx);
+
 	mad_frame_finish(&data->mframe);
 	mad_stream_finish(&data->mstream);
 	mad_synth_finish(&data->msynth);
 
+	if (data->map != NULL)
+		munmap(data->map, data->maplen);
+	g_free(data->buf_input);
 	g_slice_free(struct mp3_drv_data, data);
 }
 
 size_t
-mp3_read(struct audio_file *fd, int16_t *buf, size_t len)
+mp3_read(struct audio_file *fd, float *buf, size_t len)
 {
 	struct mp3_drv_data *data = fd->drv_data;
-	size_t written = 0;
-	int i;
+	size_t written = 0, n;
+	unsigned int channels;
+	int end;
 
 	do {
+		/* Discard the padding at the end */
+		if (data->gapless && mp3_tell(data) >= fd->frame_len)
+			goto done;
+
 		/* Get a new frame when we haven't go one */
 		if (data->cursample == 0) {
-			if (mp3_read_frame(fd) != 0)
+			if (!data->pending && mp3_read_frame(fd) != 0)
 				goto done;
-			if (mad_frame_decode(&data->mframe, &data->mstream) == -1)
+			data->pending = 0;
+			if (mad_frame_decode(&data->mframe, &data->mstream) == -1) {
+				data->skipsample = 0;
 				continue;
+			}
 
 			/* We can now set the sample rate */
 			fd->srate = data->mframe.header.samplerate;
 			fd->channels = MAD_NCHANNELS(&data->mframe.header);
 
 			mad_synth_frame(&data->msynth, &data->mframe);
+
+			/* Start halfway the frame after seeking */
+			data->cursample = data->skipsample;
+			data->skipsample = 0;
+			/* Discard the encoder and decoder delay */
+			if (data->framestart + data->cursample < 0)
+				data->cursample = MIN(-data->framestart,
+				    data->msynth.pcm.length);
 		}
 
-		while ((data->cursample < data->msynth.pcm.length) &&
-		    (written < len)) {
-			/* Write out all channels */
-			for (i = 0; i < MAD_NCHANNELS(&data->mframe.header); i++) {
-				buf[written++] = mp3_fixed_to_short(
-				    data->msynth.pcm.samples[i][data->cursample]);
-			}
+		end = data->msynth.pcm.length;
+		if (data->gapless)
+			end = CLAMP(fd->frame_len - data->framestart,
+			    data->cursample, end);
 
-			data->cursample++;
-		}
+		/*
+		 * Convert as many samples as fit at once, keeping all of
+		 * the precision of libmad. Clipping is done by the audio
+		 * output.
+		 */
+		channels = MAD_NCHANNELS(&data->mframe.header);
+		if (len - written < channels)
+			break;
+		n = MIN((size_t)(end - data->cursample),
+		    (len - written) / channels);
+		audio_dsp_from_fixed(buf + written,
+		    data->msynth.pcm.samples[0] + data->cursample,
+		    channels == 2 ?
+		    data->msynth.pcm.samples[1] + data->cursample : NULL,
+		    n, MAD_F_FRACBITS);
+		written += n * channels;
+		data->cursample += n;
 
 		/* Move on to the next frame */
 		if (data->cursample == data->msynth.pcm.length)
@@ -401,28 +1335,108 @@ mp3_read(struct audio_file *fd, int16_t *buf, size_t len)
 	} while (written < len);
 
 done:
+	fd->frame_cur = mp3_tell(data);
 	return (written);
 }
 
+/**
+ * @brief Jump close to the requested position using the seek table
+ *        when it is further away than the current position.
+ */
+static void
+mp3_seek_toc(struct audio_file *fd, int64_t frame)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	int64_t target, pos;
+	unsigned int pct;
+
+	if (!data->hastoc || data->nframes == 0)
+		return;
+
+	/* Land early enough to fill up the bit reservoir */
+	target = (frame + data->delay) / data->spf - MP3_RESERVOIR_FRAMES;
+	if (target <= 0)
+		return;
+	pct = MIN(target * 100 / data->nframes, 99);
+	pos = (int64_t)data->nframes * pct / 100 * data->spf - data->delay;
+	if (pct != 0 && pos > data->framestart + data->framelen)
+		mp3_jump(fd, data->toc[pct], pos);
+}
+
+/**
+ * @brief Jump to the entry of the frame index preceding the requested
+ *        position. Returns -1 when the index doesn't cover it yet.
+ */
+static int
+mp3_seek_index(struct audio_file *fd, int64_t frame)
+{
+	struct mp3_drv_data *data = fd->drv_data;
+	int64_t target, pos;
+	unsigned int i;
+
+	if (data->spf == 0)
+		return (-1);
+
+	/* Land early enough to fill up the bit reservoir */
+	target = (frame + data->delay) / data->spf - MP3_RESERVOIR_FRAMES;
+	if (target <= 0)
+		return (0);
+	i = target / MP3_INDEX_FRAMES;
+	if (i >= (unsigned int)g_atomic_int_get(&data->idxlen))
+		return (-1);
+
+	pos = (int64_t)i * MP3_INDEX_FRAMES * data->spf - data->delay;
+	if (pos > data->framestart + data->framelen)
+		mp3_jump(fd, data->idx[i], pos);
+	return (0);
+}
+
 void
-mp3_seek(struct audio_file *fd, int len, int rel)
+mp3_seek(struct audio_file *fd, int64_t frame)
 {
 	struct mp3_drv_data *data = fd->drv_data;
-	off_t newpos;
 
-	if (rel) {
-		/* Relative seek */
-		len += fd->time_cur;
+	if (frame < mp3_tell(data)) {
+		/* We can only scan forward */
+		mp3_rewind(fd);
+	} else if ((data->pending || data->cursample != 0) &&
+	    frame < data->framestart + data->framelen) {
+		/* Position is inside the current frame */
+		if (data->pending)
+			data->skipsample = frame - data->framestart;
+		else
+			data->cursample = frame - data->framestart;
+		fd->frame_cur = frame;
+		return;
 	}
+	data->pending = 0;
+	data->cursample = 0;
+	data->skipsample = 0;
+	/* Use the seek table until the frame index is complete enough */
+	if (mp3_seek_index(fd, frame) != 0)
+		mp3_seek_toc(fd, frame);
+
+	/*
+	 * Walk through the frame headers until we reach the frame that
+	 * contains the requested position. Only the last couple of
+	 * frames are decoded, to fill up the bit reservoir of the frame
+	 * we're going to play.
+	 */
+	for (;;) {
+		if (mp3_read_frame(fd) != 0) {
+			/* Seeked past the end of the file */
+			fd->frame_cur = data->framestart + data->framelen;
+			return;
+		}
 
-	/* Calculate the new relative position */
-	len = CLAMP(len, 0, (int)fd->time_len);
-	newpos = ((double)len / fd->time_len) * data->flen;
+		if (frame < data->framestart + data->framelen)
+			break;
+		if (frame < data->framestart +
+		    (int64_t)MP3_RESERVOIR_FRAMES * data->framelen)
+			mad_frame_decode(&data->mframe, &data->mstream);
+	}
 
-	/* Seek to the new position */
-	mp3_rewind(fd);
-	fseek(fd->fp, newpos, SEEK_SET);
-	data->mtimer.seconds = len;
-	data->mtimer.fraction = 0;
-	fd->time_cur = data->mtimer.seconds;
+	data->pending = 1;
+	data->skipsample = frame - data->framestart;
+	fd->frame_cur = frame;
 }
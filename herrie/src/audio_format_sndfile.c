@@ -58,7 +58,7 @@ sndfile_open(struct audio_file *fd, const char *ext)
 
 	fd->srate = info.samplerate;
 	fd->channels = info.channels;
-	fd->time_len = info.frames / fd->srate;
+	fd->frame_len = info.frames;
 
 	/* Metadata - libsndfile only has artist + title */
 	fd->artist = g_strdup(sf_get_string(hnd, SF_STR_ARTIST));
@@ -78,31 +78,23 @@ sndfile_close(struct audio_file *fd)
 }
 
 size_t
-sndfile_read(struct audio_file *fd, int16_t *buf, size_t len)
+sndfile_read(struct audio_file *fd, float *buf, size_t len)
 {
 	SNDFILE *hnd = fd->drv_data;
-	sf_count_t ret, frame;
+	sf_count_t ret;
 
-	ret = sf_read_short(hnd, buf, len);
+	ret = sf_read_float(hnd, buf, len);
 
 	/* Seek zero frames to obtain the current position */
-	frame = sf_seek(hnd, 0, SEEK_CUR);
-	fd->time_cur = frame / fd->srate;
+	fd->frame_cur = sf_seek(hnd, 0, SEEK_CUR);
 
 	return (ret);
 }
 
 void
-sndfile_seek(struct audio_file *fd, int len, int rel)
+sndfile_seek(struct audio_file *fd, int64_t frame)
 {
 	SNDFILE *hnd = fd->drv_data;
-	sf_count_t frame;
 
-	/* Make sure we always align the seek to seconds */
-	if (rel)
-		len += fd->time_cur;
-	len = CLAMP(len, 0, (int)fd->time_len);
-
-	frame = sf_seek(hnd, len * fd->srate, SEEK_SET);
-	fd->time_cur = frame / fd->srate;
+	fd->frame_cur = sf_seek(hnd, frame, SEEK_SET);
 }
@@ -87,8 +87,8 @@ vorbis_open(struct audio_file *fd, const char *ext)
 
 	fd->drv_data = vfp;
 	fd->srate = info->rate;
-	fd->channels = 2; /* XXX */
-	fd->time_len = ov_time_total(vfp, -1);
+	fd->channels = info->channels;
+	fd->frame_len = ov_pcm_total(vfp, -1);
 
 	vorbis_read_comments(fd);
 
@@ -108,45 +108,36 @@ vorbis_close(struct audio_file *fd)
 }
 
 size_t
-vorbis_read(struct audio_file *fd, int16_t *buf, size_t len)
+vorbis_read(struct audio_file *fd, float *buf, size_t len)
 {
 	OggVorbis_File *vfp = fd->drv_data;
 	size_t ret = 0;
-	long rlen;
-	char *out = (char *)buf;
-
-	len *= sizeof(int16_t);
-
-	/* Return 16 bits signed native endian */
-	while (ret < len) {
-#if G_BYTE_ORDER == G_BIG_ENDIAN
-		rlen = ov_read(vfp, out + ret, len - ret, 1, 2, 1, NULL);
-#else /* G_BYTE_ORDER != G_BIG_ENDIAN */
-		rlen = ov_read(vfp, out + ret, len - ret, 0, 2, 1, NULL);
-#endif /* G_BYTE_ORDER == G_BIG_ENDIAN */
+	long rlen, i;
+	unsigned int c;
+	float **pcm;
+
+	while (ret + fd->channels <= len) {
+		/* Obtain floating point samples, one array per channel */
+		rlen = ov_read_float(vfp, &pcm,
+		    (len - ret) / fd->channels, NULL);
 		if (rlen <= 0)
 			break;
-		ret += rlen;
+
+		/* Interleave the channels */
+		for (i = 0; i < rlen; i++)
+			for (c = 0; c < fd->channels; c++)
+				buf[ret++] = pcm[c][i];
 	}
-	fd->time_cur = ov_time_tell(vfp);
+	fd->frame_cur = ov_pcm_tell(vfp);
 
-	return (ret / sizeof(int16_t));
+	return (ret);
 }
 
 void
-vorbis_seek(struct audio_file *fd, int len, int rel)
+vorbis_seek(struct audio_file *fd, int64_t frame)
 {
-	double npos;
 	OggVorbis_File *vfp = fd->drv_data;
 
-	npos = len;
-	if (rel) {
-		/* Perform a relative seek. */
-		npos += ov_time_tell(vfp);
-	}
-
-	npos = CLAMP(npos, 0, ov_time_total(vfp, -1));
-
-	ov_time_seek(vfp, npos);
-	fd->time_cur = ov_time_tell(vfp);
+	ov_pcm_seek(vfp, frame);
+	fd->frame_cur = ov_pcm_tell(vfp);
 }
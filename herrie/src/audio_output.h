@@ -28,16 +28,39 @@
  * @brief Audio output abstraction.
  */
 
-struct audio_file;
+struct audio_chunk;
+
+/**
+ * @brief The maximum amount of frames written to the sound device at
+ *        once. Between writes, the audio output checks whether the
+ *        chunk has been flushed, bounding the latency of a skip.
+ */
+#define AUDIO_OUTPUT_SLICE	256
 
 /**
  * @brief Open the sound device for audio output.
  */
 int audio_output_open(void);
 /**
- * @brief Write data to the sound device.
+ * @brief Write a chunk of decoded audio to the sound device.
+ */
+int audio_output_play(const struct audio_chunk *ac);
+/**
+ * @brief Discard the audio that has been written to the sound device,
+ *        but has not been played yet.
+ */
+void audio_output_flush(void);
+/**
+ * @brief Pause or resume playback of the audio that has been written
+ *        to the sound device. When not supported by the sound device,
+ *        the audio already written is played out.
+ */
+void audio_output_pause(int pause);
+/**
+ * @brief Return the amount of frames that have been written to the
+ *        sound device, but have not been played yet.
  */
-int audio_output_play(struct audio_file *fd);
+unsigned int audio_output_delay(void);
 /**
  * @brief Close the sound device.
  */
@@ -32,7 +32,8 @@
 
 #include <alsa/asoundlib.h>
 
-#include "audio_file.h"
+#include "audio_buffer.h"
+#include "audio_dsp.h"
 #include "audio_output.h"
 #include "config.h"
 #include "gui.h"
@@ -49,6 +50,10 @@ static unsigned int		channels = 0;
  * @brief the sample rate that is currently used for playback.
  */
 static unsigned int		srate = 0;
+/**
+ * @brief Whether the audio device supports pausing playback.
+ */
+static int			canpause = 0;
 #ifdef BUILD_VOLUME
 /**
  * @brief Handle to the ALSA mixer.
@@ -60,6 +65,12 @@ static snd_mixer_t *mixhnd = NULL;
 static snd_mixer_elem_t *elem;
 #endif /* BUILD_VOLUME */
 
+/**
+ * @brief Samples of the chunk that is being played, converted to the
+ *        format of the audio device.
+ */
+static int16_t		devbuf[AUDIO_CHUNK_LEN];
+
 /**
  * @brief Alter the audio output parameters of the audio output device.
  */
@@ -97,6 +108,7 @@ audio_output_apply_hwparams(void)
 	if (snd_pcm_hw_params(devhnd, devparam) != 0)
 		return (-1);
 
+	canpause = snd_pcm_hw_params_can_pause(devparam);
 	return (0);
 }
 
@@ -153,18 +165,14 @@ error:
 }
 
 int
-audio_output_play(struct audio_file *fd)
+audio_output_play(const struct audio_chunk *ac)
 {
-	int16_t buf[8192];
 	snd_pcm_sframes_t ret, len, done = 0;
 
-	if ((len = audio_file_read(fd, buf, sizeof buf / sizeof(int16_t))) == 0)
-		return (-1);
-
-	if (fd->channels != channels || fd->srate != srate) {
+	if (ac->channels != channels || ac->srate != srate) {
 		/* Apply the new values */
-		channels = fd->channels;
-		srate = fd->srate;
+		channels = ac->channels;
+		srate = ac->srate;
 		if (audio_output_apply_hwparams() != 0) {
 			gui_msgbar_warn(_("Sample rate or amount of channels not supported."));
 			/* Invalidate the old settings */
@@ -173,12 +181,19 @@ audio_output_play(struct audio_file *fd)
 		}
 	}
 
+	audio_dsp_to_s16(devbuf, ac->buf, ac->len);
+
 	/* ALSA measures in sample lengths */
-	len /= fd->channels;
+	len = ac->len / ac->channels;
 
 	/* Our complex error handling for snd_pcm_writei() */
 	while (done < len) {
-		ret = snd_pcm_writei(devhnd, buf + (done * fd->channels), len - done);
+		/* The chunk has been flushed while writing it */
+		if (audio_buffer_stale(ac))
+			return (0);
+
+		ret = snd_pcm_writei(devhnd, devbuf + (done * ac->channels),
+		    MIN(len - done, AUDIO_OUTPUT_SLICE));
 		if (ret == -EPIPE) {
 			/* Buffer underrun. Try again. */
 			if (snd_pcm_prepare(devhnd) != 0)
@@ -195,6 +210,39 @@ audio_output_play(struct audio_file *fd)
 	return (0);
 }
 
+void
+audio_output_flush(void)
+{
+	/* Throw away the contents of the hardware buffer */
+	snd_pcm_drop(devhnd);
+	snd_pcm_prepare(devhnd);
+}
+
+void
+audio_output_pause(int pause)
+{
+	snd_pcm_state_t state;
+
+	if (!canpause)
+		return;
+
+	state = snd_pcm_state(devhnd);
+	if (pause && state == SND_PCM_STATE_RUNNING)
+		snd_pcm_pause(devhnd, 1);
+	else if (!pause && state == SND_PCM_STATE_PAUSED)
+		snd_pcm_pause(devhnd, 0);
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	snd_pcm_sframes_t delay;
+
+	if (snd_pcm_delay(devhnd, &delay) != 0 || delay < 0)
+		return (0);
+	return (delay);
+}
+
 void
 audio_output_close(void)
 {
@@ -32,7 +32,8 @@
 
 #include <ao/ao.h>
 
-#include "audio_file.h"
+#include "audio_buffer.h"
+#include "audio_dsp.h"
 #include "audio_output.h"
 #include "config.h"
 #include "gui.h"
@@ -50,6 +51,22 @@ static ao_sample_format	devfmt;
  *        audio device.
  */
 static ao_option	*devopt = NULL;
+/**
+ * @brief Samples of the chunk that is being played, converted to the
+ *        format of the audio device.
+ */
+static int16_t		devbuf[AUDIO_CHUNK_LEN];
+/**
+ * @brief Time at which the device handle started playing the audio
+ *        that is counted in devwritten.
+ */
+static gint64		devstart = 0;
+/**
+ * @brief Amount of frames written to the device handle since devstart.
+ *        libao cannot report its delay, so it is estimated by comparing
+ *        it to the time that has passed.
+ */
+static int64_t		devwritten = 0;
 
 int
 audio_output_open(void)
@@ -83,22 +100,19 @@ audio_output_open(void)
 }
 
 int
-audio_output_play(struct audio_file *fd)
+audio_output_play(const struct audio_chunk *ac)
 {
 	const char *drvname;
-	int16_t buf[2048];
-	int len, drvnum;
-
-	if ((len = audio_file_read(fd, buf, sizeof buf / sizeof(int16_t))) == 0)
-		return (-1);
+	int drvnum;
+	size_t len, done;
 
-	if ((unsigned int)devfmt.rate != fd->srate ||
-	    (unsigned int)devfmt.channels != fd->channels) {
+	if ((unsigned int)devfmt.rate != ac->srate ||
+	    (unsigned int)devfmt.channels != ac->channels) {
 		/* Sample rate or amount of channels has changed */
 		audio_output_close();
 
-		devfmt.rate = fd->srate;
-		devfmt.channels = fd->channels;
+		devfmt.rate = ac->srate;
+		devfmt.channels = ac->channels;
 	}
 
 	if (devptr == NULL) {
@@ -118,15 +132,56 @@ audio_output_play(struct audio_file *fd)
 		}
 	}
 
-	if (ao_play(devptr, (char *)buf, len * sizeof(int16_t)) == 0) {
-		/* No success - device must be closed */
-		audio_output_close();
-		return (-1);
+	audio_dsp_to_s16(devbuf, ac->buf, ac->len);
+
+	for (done = 0; done < ac->len; done += len) {
+		/* The chunk has been flushed while writing it */
+		if (audio_buffer_stale(ac))
+			break;
+
+		len = MIN(ac->len - done, AUDIO_OUTPUT_SLICE * ac->channels);
+		if (audio_output_delay() == 0) {
+			/* The device has run dry - start counting again */
+			devstart = g_get_monotonic_time();
+			devwritten = 0;
+		}
+		if (ao_play(devptr, (char *)(devbuf + done),
+		    len * sizeof(int16_t)) == 0) {
+			/* No success - device must be closed */
+			audio_output_close();
+			return (-1);
+		}
+		devwritten += len / ac->channels;
 	}
 
 	return (0);
 }
 
+void
+audio_output_flush(void)
+{
+	/* libao offers no way to discard written audio */
+}
+
+void
+audio_output_pause(int pause)
+{
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	int64_t played;
+
+	if (devptr == NULL)
+		return (0);
+
+	played = (g_get_monotonic_time() - devstart) * devfmt.rate / 1000000;
+	if (played >= devwritten)
+		return (0);
+	return (devwritten - played);
+}
+
 void
 audio_output_close(void)
 {
@@ -134,5 +189,6 @@ audio_output_close(void)
 		/* Close device */
 		ao_close(devptr);
 		devptr = NULL;
+		devwritten = 0;
 	}
 }
@@ -32,7 +32,7 @@
 
 #include <CoreAudio/AudioHardware.h>
 
-#include "audio_file.h"
+#include "audio_buffer.h"
 #include "audio_output.h"
 #include "gui.h"
 
@@ -70,11 +70,11 @@ AudioDeviceIOProcID		aprocid;
  * @brief The buffer that will be played when the current buffer is
  *        finished processing.
  */
-int16_t				*abufnew;
+float				*abufnew;
 /**
  * @brief The buffer that is currently processed by CoreAudio.
  */
-int16_t				*abufcur;
+float				*abufcur;
 /**
  * @brief The length of the buffers used by CoreAudio.
  */
@@ -117,7 +117,7 @@ audio_output_ioproc(AudioDeviceID inDevice, const AudioTimeStamp *inNow,
     AudioBufferList *outOutputData, const AudioTimeStamp *inOutputTime,
     void *inClientData)
 {
-	int i, len;
+	int len;
 	float *ob = outOutputData->mBuffers[0].mData;
 
 	/* Stop the IOProc handling if we're going idle */
@@ -125,17 +125,15 @@ audio_output_ioproc(AudioDeviceID inDevice, const AudioTimeStamp *inNow,
 	if (len == 0)
 		AudioDeviceStop(adid, aprocid);
 
-	/* Convert the data to floats */
-	for (i = 0; i < len; i++)
-		ob[i] = (float)abufcur[i] / SHRT_MAX;
+	/* Samples are already in the native format */
+	memcpy(ob, abufcur, len * sizeof(float));
 
 	/* Empty the buffer and notify that we can receive new data */
 	g_atomic_int_set(&abufulen, 0);
 	g_cond_signal(&abufdrained);
 
 	/* Fill the trailer with zero's */
-	for (; i < abuflen; i++)
-		ob[i] = 0.0;
+	memset(ob + len, 0, (abuflen - len) * sizeof(float));
 
 	return (0);
 }
@@ -252,8 +250,8 @@ audio_output_open(void)
 
 	/* The buffer size reported is in floats */
 	abuflen /= sizeof(float);
-	abufnew = g_malloc(abuflen * sizeof(int16_t));
-	abufcur = g_malloc(abuflen * sizeof(int16_t));
+	abufnew = g_malloc(abuflen * sizeof(float));
+	abufcur = g_malloc(abuflen * sizeof(float));
 
 	/* Locking down the buffer length */
 	g_mutex_init(&abuflock);
@@ -275,20 +273,17 @@ error:
 }
 
 int
-audio_output_play(struct audio_file *fd)
+audio_output_play(const struct audio_chunk *ac)
 {
 	UInt32 len, size, adsnew;
-	int16_t *tmp;
+	size_t done;
+	float *tmp;
 
-	/* Read data in our temporary buffer */
-	if ((len = audio_file_read(fd, abufnew, abuflen)) == 0)
-		return (-1);
-
-	if (fd->srate != afmt.mSampleRate ||
-	    fd->channels != afmt.mChannelsPerFrame) {
+	if (ac->srate != afmt.mSampleRate ||
+	    ac->channels != afmt.mChannelsPerFrame) {
 		/* Sample rate or the amount of channels has changed */
-		afmt.mSampleRate = fd->srate;
-		afmt.mChannelsPerFrame = fd->channels;
+		afmt.mSampleRate = ac->srate;
+		afmt.mChannelsPerFrame = ac->channels;
 
 		size = sizeof afmt;
 #ifdef MAC_OS_X_VERSION_10_5
@@ -318,36 +313,77 @@ audio_output_play(struct audio_file *fd)
 		}
 	}
 
-	/* XXX: Mutex not actually needed - only for the condvar */
-	g_mutex_lock(&abuflock);
-	while (g_atomic_int_get(&abufulen) != 0)
-		g_cond_wait(&abufdrained, &abuflock);
-	g_mutex_unlock(&abuflock);
+	for (done = 0; done < ac->len; done += len) {
+		/* The chunk has been flushed while writing it */
+		if (audio_buffer_stale(ac))
+			break;
 
-	/* Toggle the buffers */
-	tmp = abufcur;
-	abufcur = abufnew;
-	abufnew = tmp;
+		/* Copy data in our temporary buffer */
+		len = MIN(ac->len - done, (size_t)abuflen);
+		memcpy(abufnew, ac->buf + done, len * sizeof(float));
 
-	/* Atomically set the usage length */
-	g_atomic_int_set(&abufulen, len);
+		/* XXX: Mutex not actually needed - only for the condvar */
+		g_mutex_lock(&abuflock);
+		while (g_atomic_int_get(&abufulen) != 0)
+			g_cond_wait(&abufdrained, &abuflock);
+		g_mutex_unlock(&abuflock);
 
-	/* Check if the data source changed */
-	if (audio_output_get_datasource(&adsnew) != 0)
-		return (-1);
+		/* Toggle the buffers */
+		tmp = abufcur;
+		abufcur = abufnew;
+		abufnew = tmp;
 
-	if (adscur != adsnew) {
-		/* Restart the device */
-		AudioDeviceStop(adid, aprocid);
-		adscur = adsnew;
-	}
+		/* Atomically set the usage length */
+		g_atomic_int_set(&abufulen, len);
 
-	/* Start processing of the data */
-	AudioDeviceStart(adid, aprocid);
+		/* Check if the data source changed */
+		if (audio_output_get_datasource(&adsnew) != 0)
+			return (-1);
+
+		if (adscur != adsnew) {
+			/* Restart the device */
+			AudioDeviceStop(adid, aprocid);
+			adscur = adsnew;
+		}
+
+		/* Start processing of the data */
+		AudioDeviceStart(adid, aprocid);
+	}
 
 	return (0);
 }
 
+void
+audio_output_flush(void)
+{
+	/* Discard the buffer the IOProc has not picked up yet */
+	AudioDeviceStop(adid, aprocid);
+	g_mutex_lock(&abuflock);
+	g_atomic_int_set(&abufulen, 0);
+	g_cond_signal(&abufdrained);
+	g_mutex_unlock(&abuflock);
+}
+
+void
+audio_output_pause(int pause)
+{
+	if (pause)
+		AudioDeviceStop(adid, aprocid);
+	else if (g_atomic_int_get(&abufulen) != 0)
+		AudioDeviceStart(adid, aprocid);
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	if (afmt.mChannelsPerFrame == 0)
+		return (0);
+
+	/* The pending buffer and the one being played by the device */
+	return ((g_atomic_int_get(&abufulen) + abuflen) /
+	    afmt.mChannelsPerFrame);
+}
+
 void
 audio_output_close(void)
 {
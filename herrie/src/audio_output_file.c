@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_output_file.c
+ * @brief File audio output driver, writing WAV or raw PCM to a file or
+ *        to standard output as fast as the audio is decoded.
+ */
+
+#include "stdinc.h"
+
+#include <sys/resource.h>
+#include <sys/time.h>
+
+#include "audio_buffer.h"
+#include "audio_dsp.h"
+#include "audio_output.h"
+#include "config.h"
+#include "gui.h"
+
+/**
+ * @brief File descriptor the audio is written to.
+ */
+static int		devfd = -1;
+/**
+ * @brief Whether a WAV header should be written in front of the audio.
+ */
+static int		devwav;
+/**
+ * @brief Sample rate of the audio written so far.
+ */
+static unsigned int	cur_srate = 0;
+/**
+ * @brief Amount of channels of the audio written so far.
+ */
+static unsigned int	cur_channels = 0;
+/**
+ * @brief Amount of bytes of audio written to the file.
+ */
+static uint64_t		devbytes = 0;
+/**
+ * @brief Samples of the chunk that is being written, converted to
+ *        16 bits little endian.
+ */
+static int16_t		devbuf[AUDIO_CHUNK_LEN];
+
+/**
+ * @brief Amount of frames of the current song written to the file.
+ */
+static int64_t		stat_frames = 0;
+/**
+ * @brief Position in the song of the last chunk, used to notice the
+ *        start of the next song.
+ */
+static int64_t		stat_pos;
+/**
+ * @brief Time at which rendering of the current song started.
+ */
+static gint64		stat_start;
+/**
+ * @brief Time at which the last chunk of the current song was written.
+ */
+static gint64		stat_end;
+/**
+ * @brief CPU time used by the application when rendering of the
+ *        current song started.
+ */
+static double		stat_cpu;
+/**
+ * @brief Statistics of the last song, printed when the application
+ *        exits.
+ */
+static char		*stat_last = NULL;
+
+/**
+ * @brief Return the CPU time used by all threads of the application in
+ *        seconds.
+ */
+static double
+audio_output_cputime(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+		return (0.0);
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec +
+	    (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0);
+}
+
+/**
+ * @brief Describe the rendering speed of the current song and reset
+ *        the statistics. Returns NULL when nothing has been rendered.
+ */
+static char *
+audio_output_stats(void)
+{
+	int64_t frames;
+	double secs;
+
+	if (stat_frames == 0)
+		return (NULL);
+
+	frames = stat_frames;
+	stat_frames = 0;
+	secs = MAX(stat_end - stat_start, 1) / 1000000.0;
+	return g_strdup_printf(
+	    _("Rendered %lld frames: %.0f frames/s, %.2fs CPU time"),
+	    (long long)frames, frames / secs,
+	    audio_output_cputime() - stat_cpu);
+}
+
+/**
+ * @brief Print the statistics of the last song after the user
+ *        interface has been torn down.
+ */
+static void
+audio_output_atexit(void)
+{
+	if (stat_last != NULL)
+		g_printerr("%s\n", stat_last);
+}
+
+/**
+ * @brief Write a buffer to the file, retrying after short writes.
+ */
+static int
+audio_output_write(const void *buf, size_t len)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(devfd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return (-1);
+		}
+		p += ret;
+		len -= ret;
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Store a 16 or 32 bits little endian value in a WAV header.
+ */
+static void
+audio_output_put(unsigned char *p, uint32_t val, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		p[i] = val >> (i * 8);
+}
+
+/**
+ * @brief Write a WAV header describing the current format. The lengths
+ *        are only known when the file is closed, so they are set to
+ *        their maximum, which is how pipes expect them.
+ */
+static int
+audio_output_header(uint32_t len, off_t offset)
+{
+	unsigned char hdr[44];
+
+	memcpy(hdr, "RIFF", 4);
+	audio_output_put(hdr + 4, len == UINT32_MAX ? len : len + 36, 4);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	audio_output_put(hdr + 16, 16, 4);
+	/* Integer PCM */
+	audio_output_put(hdr + 20, 1, 2);
+	audio_output_put(hdr + 22, cur_channels, 2);
+	audio_output_put(hdr + 24, cur_srate, 4);
+	audio_output_put(hdr + 28, cur_srate * cur_channels * 2, 4);
+	audio_output_put(hdr + 32, cur_channels * 2, 2);
+	audio_output_put(hdr + 34, 16, 2);
+	memcpy(hdr + 36, "data", 4);
+	audio_output_put(hdr + 40, len, 4);
+
+	if (offset == -1)
+		return audio_output_write(hdr, sizeof hdr);
+	return (pwrite(devfd, hdr, sizeof hdr, offset) == sizeof hdr ? 0 : -1);
+}
+
+int
+audio_output_open(void)
+{
+	const char *path;
+	int tty;
+
+	devwav = strcmp(config_getopt("audio.output.file.format"), "wav") == 0;
+
+	path = config_getopt("audio.output.file.path");
+	if (strcmp(path, "-") == 0) {
+		/* Keep standard output for ourselves */
+		devfd = dup(STDOUT_FILENO);
+		if (devfd == -1)
+			goto error;
+
+		/* Let the user interface draw on the terminal instead */
+		if ((tty = open("/dev/tty", O_WRONLY)) != -1) {
+			dup2(tty, STDOUT_FILENO);
+			close(tty);
+		}
+	} else {
+		devfd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+		if (devfd == -1)
+			goto error;
+	}
+
+	atexit(audio_output_atexit);
+	return (0);
+error:
+	g_printerr(_("Cannot open audio device \"%s\".\n"), path);
+	return (-1);
+}
+
+int
+audio_output_play(const struct audio_chunk *ac)
+{
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	size_t i;
+#endif /* G_BYTE_ORDER == G_BIG_ENDIAN */
+	char *stats;
+
+	if (ac->frame < stat_pos && (stats = audio_output_stats()) != NULL) {
+		/* The previous song has been rendered completely */
+		gui_msgbar_warn(stats);
+		g_free(stats);
+	}
+	if (stat_frames == 0) {
+		stat_start = g_get_monotonic_time();
+		stat_cpu = audio_output_cputime();
+	}
+	stat_pos = ac->frame;
+
+	if (cur_srate != ac->srate || cur_channels != ac->channels) {
+		/* A WAV file can only contain a single format */
+		if (devwav && cur_srate != 0) {
+			gui_msgbar_warn(_("Sample rate or amount of channels not supported."));
+			return (-1);
+		}
+
+		cur_srate = ac->srate;
+		cur_channels = ac->channels;
+		if (devwav && audio_output_header(UINT32_MAX, -1) != 0)
+			goto bad;
+	}
+
+	audio_dsp_to_s16(devbuf, ac->buf, ac->len);
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	for (i = 0; i < ac->len; i++)
+		devbuf[i] = GUINT16_SWAP_LE_BE(devbuf[i]);
+#endif /* G_BYTE_ORDER == G_BIG_ENDIAN */
+
+	/* No need to throttle - write the entire chunk at once */
+	if (audio_output_write(devbuf, ac->len * sizeof(int16_t)) != 0)
+		goto bad;
+	devbytes += ac->len * sizeof(int16_t);
+
+	stat_frames += ac->len / ac->channels;
+	stat_end = g_get_monotonic_time();
+	return (0);
+bad:
+	gui_msgbar_warn(_("Cannot write to the audio file."));
+	return (-1);
+}
+
+void
+audio_output_flush(void)
+{
+	/* Audio is written right away, so nothing is queued */
+}
+
+void
+audio_output_pause(int pause)
+{
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	return (0);
+}
+
+void
+audio_output_close(void)
+{
+	if (devfd == -1)
+		return;
+
+	/* Fill in the lengths when the file permits it */
+	if (devwav && cur_srate != 0 && devbytes < UINT32_MAX - 36)
+		audio_output_header(devbytes, 0);
+
+	close(devfd);
+	devfd = -1;
+
+	stat_last = audio_output_stats();
+}
@@ -0,0 +1,589 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_output_httpd.c
+ * @brief HTTP audio output driver, serving the audio as WAV or raw PCM
+ *        to any amount of listeners.
+ */
+
+#include "stdinc.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netdb.h>
+#include <poll.h>
+
+#include "audio_buffer.h"
+#include "audio_dsp.h"
+#include "audio_output.h"
+#include "config.h"
+#include "gui.h"
+
+/*
+ * Audio is converted once and stored in a ring buffer shared by all
+ * listeners. Each listener only has a position in the stream, so the
+ * server thread sends the audio straight from the ring buffer using
+ * writev(). Listeners that fall behind by more than the size of the
+ * ring buffer are disconnected, so they can never stall playback.
+ */
+
+/**
+ * @brief Size of the socket send buffer of a listener. Without a limit,
+ *        the kernel buffers megabytes of audio for a slow listener
+ *        before it falls behind in the ring buffer.
+ */
+#define HTTPD_SNDBUF	65536
+
+/**
+ * @brief A listener connected to the server.
+ */
+struct audio_output_client {
+	/**
+	 * @brief Socket of the connection.
+	 */
+	int		fd;
+	/**
+	 * @brief Amount of characters of the blank line terminating the
+	 *        request that have been received.
+	 */
+	int		reqstate;
+	/**
+	 * @brief Response header, sent in front of the audio.
+	 */
+	char		hdr[256];
+	/**
+	 * @brief Length of the response header, or zero when it has not
+	 *        been generated yet.
+	 */
+	size_t		hdrlen;
+	/**
+	 * @brief Amount of bytes of the response header that have been
+	 *        sent.
+	 */
+	size_t		hdroff;
+	/**
+	 * @brief Format generation the response header describes.
+	 */
+	unsigned int	epoch;
+	/**
+	 * @brief Position in the stream of the next byte to be sent.
+	 */
+	uint64_t	pos;
+};
+
+/**
+ * @brief Socket accepting new listeners.
+ */
+static int		srv_fd = -1;
+/**
+ * @brief Pipe used to wake up the server thread.
+ */
+static int		srv_wakeup[2] = { -1, -1 };
+/**
+ * @brief Thread serving the listeners.
+ */
+static GThread		*srv_thread = NULL;
+/**
+ * @brief Tell the server thread to stop.
+ */
+static volatile int	srv_quit = 0;
+/**
+ * @brief Listeners connected to the server. Only used by the server
+ *        thread.
+ */
+static GPtrArray	*clients;
+/**
+ * @brief Lock protecting the ring buffer and the format.
+ */
+static GMutex		ring_mtx;
+/**
+ * @brief Ring buffer containing the most recent audio.
+ */
+static char		*ring = NULL;
+/**
+ * @brief Size of the ring buffer in bytes.
+ */
+static size_t		ringlen = 0;
+/**
+ * @brief Position in the stream of the next byte written to the ring
+ *        buffer.
+ */
+static uint64_t		ringhead = 0;
+/**
+ * @brief Generation of the format, increased when the format changes.
+ */
+static unsigned int	epoch = 0;
+/**
+ * @brief Sample rate of the stream.
+ */
+static unsigned int	cur_srate = 0;
+/**
+ * @brief Amount of channels of the stream.
+ */
+static unsigned int	cur_channels = 0;
+/**
+ * @brief Samples of the chunk that is being played, converted to
+ *        16 bits little endian.
+ */
+static int16_t		devbuf[AUDIO_CHUNK_LEN];
+/**
+ * @brief Time at which playback of the stream started.
+ */
+static gint64		pace_base;
+/**
+ * @brief Amount of frames sent since pace_base.
+ */
+static int64_t		pace_frames;
+
+/**
+ * @brief Whether the stream starts with a WAV header.
+ */
+static int		devwav;
+/**
+ * @brief Amount of audio in microseconds a listener may fall behind.
+ */
+static unsigned int	buffer_time;
+/**
+ * @brief Maximum amount of listeners.
+ */
+static unsigned int	maxclients;
+
+/**
+ * @brief Store a 16 or 32 bits little endian value in a WAV header.
+ */
+static void
+audio_output_put(char *p, uint32_t val, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		p[i] = val >> (i * 8);
+}
+
+/**
+ * @brief Wake up the server thread.
+ */
+static void
+audio_output_wakeup(void)
+{
+	char c = 0;
+
+	write(srv_wakeup[1], &c, 1);
+}
+
+/**
+ * @brief Generate the response header of a listener that has sent its
+ *        request. The ring_mtx should be held.
+ */
+static void
+audio_output_client_header(struct audio_output_client *c)
+{
+	char *p;
+
+	c->hdrlen = g_snprintf(c->hdr, sizeof c->hdr,
+	    "HTTP/1.0 200 OK\r\n"
+	    "Content-Type: %s\r\n"
+	    "Cache-Control: no-cache\r\n"
+	    "\r\n", devwav ? "audio/wav" : "application/octet-stream");
+
+	if (devwav) {
+		/* The length is unknown, so use the maximum */
+		p = c->hdr + c->hdrlen;
+		memcpy(p, "RIFF", 4);
+		audio_output_put(p + 4, UINT32_MAX, 4);
+		memcpy(p + 8, "WAVEfmt ", 8);
+		audio_output_put(p + 16, 16, 4);
+		audio_output_put(p + 20, 1, 2);
+		audio_output_put(p + 22, cur_channels, 2);
+		audio_output_put(p + 24, cur_srate, 4);
+		audio_output_put(p + 28, cur_srate * cur_channels * 2, 4);
+		audio_output_put(p + 32, cur_channels * 2, 2);
+		audio_output_put(p + 34, 16, 2);
+		memcpy(p + 36, "data", 4);
+		audio_output_put(p + 40, UINT32_MAX, 4);
+		c->hdrlen += 44;
+	}
+
+	/* Start with the audio that is being played right now */
+	c->epoch = epoch;
+	c->pos = ringhead;
+}
+
+/**
+ * @brief Disconnect a listener.
+ */
+static void
+audio_output_client_drop(unsigned int idx)
+{
+	struct audio_output_client *c;
+
+	c = g_ptr_array_index(clients, idx);
+	close(c->fd);
+	g_slice_free(struct audio_output_client, c);
+	g_ptr_array_remove_index_fast(clients, idx);
+}
+
+/**
+ * @brief Read the request of a listener, which is ignored apart from
+ *        the blank line terminating it.
+ */
+static int
+audio_output_client_read(struct audio_output_client *c)
+{
+	static const char term[] = "\r\n\r\n";
+	char buf[512];
+	ssize_t len, i;
+
+	len = read(c->fd, buf, sizeof buf);
+	if (len == 0 || (len < 0 && errno != EAGAIN && errno != EINTR))
+		return (-1);
+
+	for (i = 0; i < len && c->reqstate < 4; i++) {
+		if (buf[i] == term[c->reqstate])
+			c->reqstate++;
+		else
+			c->reqstate = buf[i] == '\r';
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Send as much of the stream to a listener as its socket
+ *        accepts. The ring_mtx should be held.
+ */
+static int
+audio_output_client_write(struct audio_output_client *c)
+{
+	struct iovec iov[3];
+	uint64_t avail;
+	size_t off, len;
+	ssize_t ret;
+	int n = 0;
+
+	if (c->hdroff < c->hdrlen) {
+		iov[n].iov_base = c->hdr + c->hdroff;
+		iov[n++].iov_len = c->hdrlen - c->hdroff;
+	}
+
+	/*
+	 * The ring buffer may have been filled or replaced while we
+	 * were waiting in poll(), so check again before touching it.
+	 */
+	if (c->hdrlen != 0 &&
+	    (c->epoch != epoch || ringhead - c->pos > ringlen))
+		return (-1);
+
+	/* The audio may wrap around the end of the ring buffer */
+	avail = ringhead - c->pos;
+	off = c->pos % ringlen;
+	if (avail > 0) {
+		len = MIN(avail, ringlen - off);
+		iov[n].iov_base = ring + off;
+		iov[n++].iov_len = len;
+		if (avail > len) {
+			iov[n].iov_base = ring;
+			iov[n++].iov_len = avail - len;
+		}
+	}
+	if (n == 0)
+		return (0);
+
+	/* SIGPIPE is blocked in this thread, so we just get EPIPE */
+	ret = writev(c->fd, iov, n);
+	if (ret < 0)
+		return (errno == EAGAIN || errno == EINTR ? 0 : -1);
+
+	len = MIN((size_t)ret, c->hdrlen - c->hdroff);
+	c->hdroff += len;
+	c->pos += ret - len;
+	return (0);
+}
+
+/**
+ * @brief Accept new listeners and send the stream to them.
+ */
+static void *
+audio_output_server(void *unused)
+{
+	struct audio_output_client *c;
+	struct pollfd *pfd;
+	unsigned int i, n, first;
+	char buf[64];
+	int fd, sndbuf = HTTPD_SNDBUF;
+
+	gui_input_sigmask();
+	pfd = g_new(struct pollfd, maxclients + 2);
+
+	while (!srv_quit) {
+		pfd[0].fd = srv_wakeup[0];
+		pfd[0].events = POLLIN;
+		pfd[1].fd = srv_fd;
+		pfd[1].events = clients->len < maxclients ? POLLIN : 0;
+		first = n = 2;
+
+		g_mutex_lock(&ring_mtx);
+		for (i = clients->len; i-- > 0; ) {
+			c = g_ptr_array_index(clients, i);
+			if (c->reqstate == 4 && c->hdrlen == 0 && cur_srate != 0)
+				audio_output_client_header(c);
+
+			if (c->hdrlen != 0 && (c->epoch != epoch ||
+			    ringhead - c->pos > ringlen)) {
+				/* Format has changed or listener is too slow */
+				audio_output_client_drop(i);
+				continue;
+			}
+		}
+		for (i = 0; i < clients->len; i++) {
+			c = g_ptr_array_index(clients, i);
+			pfd[n].fd = c->fd;
+			pfd[n].events = POLLIN;
+			if (c->hdroff < c->hdrlen || (c->hdrlen != 0 &&
+			    c->pos != ringhead))
+				pfd[n].events |= POLLOUT;
+			pfd[n++].revents = 0;
+		}
+		g_mutex_unlock(&ring_mtx);
+
+		if (poll(pfd, n, -1) < 0)
+			continue;
+
+		/* Discard the wakeups */
+		if (pfd[0].revents & POLLIN)
+			while (read(srv_wakeup[0], buf, sizeof buf) > 0) ;
+
+		g_mutex_lock(&ring_mtx);
+		for (i = n - first; i-- > 0; ) {
+			c = g_ptr_array_index(clients, i);
+			if ((pfd[first + i].revents & (POLLIN|POLLHUP|POLLERR) &&
+			    audio_output_client_read(c) != 0) ||
+			    (pfd[first + i].revents & POLLOUT &&
+			    audio_output_client_write(c) != 0))
+				audio_output_client_drop(i);
+		}
+		g_mutex_unlock(&ring_mtx);
+
+		if (pfd[1].revents & POLLIN &&
+		    (fd = accept(srv_fd, NULL, NULL)) != -1) {
+			/* New listener */
+			fcntl(fd, F_SETFL, O_NONBLOCK);
+			setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf,
+			    sizeof sndbuf);
+			c = g_slice_new0(struct audio_output_client);
+			c->fd = fd;
+			g_ptr_array_add(clients, c);
+		}
+	}
+
+	g_free(pfd);
+	return (NULL);
+}
+
+int
+audio_output_open(void)
+{
+	struct addrinfo hints, *res, *ai;
+	const char *addr;
+	char port[16];
+	int on = 1;
+
+	devwav = strcmp(config_getopt("audio.output.httpd.format"), "wav") == 0;
+	buffer_time = config_getopt_number("audio.output.httpd.buffer_time");
+	maxclients = MAX(config_getopt_number("audio.output.httpd.clients"), 1);
+
+	/* Listen on all addresses when none is given */
+	addr = config_getopt("audio.output.httpd.address");
+	g_snprintf(port, sizeof port, "%u",
+	    config_getopt_number("audio.output.httpd.port"));
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if (getaddrinfo(addr[0] != '\0' ? addr : NULL, port, &hints, &res) != 0)
+		goto error;
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		srv_fd = socket(ai->ai_family, ai->ai_socktype,
+		    ai->ai_protocol);
+		if (srv_fd == -1)
+			continue;
+		setsockopt(srv_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof on);
+		if (bind(srv_fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+		    listen(srv_fd, 16) == 0)
+			break;
+		close(srv_fd);
+		srv_fd = -1;
+	}
+	freeaddrinfo(res);
+	if (srv_fd == -1 || pipe(srv_wakeup) != 0)
+		goto error;
+
+	/* Neither the server thread nor the wakeups may block */
+	fcntl(srv_fd, F_SETFL, O_NONBLOCK);
+	fcntl(srv_wakeup[0], F_SETFL, O_NONBLOCK);
+	fcntl(srv_wakeup[1], F_SETFL, O_NONBLOCK);
+
+	g_mutex_init(&ring_mtx);
+	clients = g_ptr_array_new();
+	srv_thread = g_thread_new("httpd", audio_output_server, NULL);
+
+	return (0);
+error:
+	g_printerr(_("Cannot listen on port %s.\n"), port);
+	return (-1);
+}
+
+/**
+ * @brief Throttle the audio to the speed at which it is played. The
+ *        stream may run ahead by a quarter of the buffer, so listeners
+ *        can build up a small buffer of their own.
+ */
+static void
+audio_output_pace(size_t frames)
+{
+	gint64 now, ahead;
+
+	now = g_get_monotonic_time();
+	ahead = pace_frames * 1000000 / cur_srate - (now - pace_base);
+	if (ahead < 0) {
+		/* Playback has stalled or paused - don't catch up */
+		pace_base = now;
+		pace_frames = 0;
+	} else if (ahead > buffer_time / 4) {
+		g_usleep(ahead - buffer_time / 4);
+	}
+
+	pace_frames += frames;
+}
+
+int
+audio_output_play(const struct audio_chunk *ac)
+{
+	size_t len, done, bytes, off;
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	size_t i;
+#endif /* G_BYTE_ORDER == G_BIG_ENDIAN */
+
+	if (cur_srate != ac->srate || cur_channels != ac->channels) {
+		/* Listeners can only handle a single format */
+		g_mutex_lock(&ring_mtx);
+		cur_srate = ac->srate;
+		cur_channels = ac->channels;
+		ringlen = (uint64_t)buffer_time * cur_srate / 1000000 *
+		    cur_channels * sizeof(int16_t);
+		ringlen = MAX(ringlen,
+		    4 * AUDIO_OUTPUT_SLICE * cur_channels * sizeof(int16_t));
+		g_free(ring);
+		ring = g_malloc(ringlen);
+		ringhead = 0;
+		epoch++;
+		g_mutex_unlock(&ring_mtx);
+
+		pace_base = g_get_monotonic_time();
+		pace_frames = 0;
+	}
+
+	audio_dsp_to_s16(devbuf, ac->buf, ac->len);
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+	for (i = 0; i < ac->len; i++)
+		devbuf[i] = GUINT16_SWAP_LE_BE(devbuf[i]);
+#endif /* G_BYTE_ORDER == G_BIG_ENDIAN */
+
+	for (done = 0; done < ac->len; done += len) {
+		/* The chunk has been flushed while playing it */
+		if (audio_buffer_stale(ac))
+			break;
+
+		len = MIN(ac->len - done, AUDIO_OUTPUT_SLICE * ac->channels);
+		audio_output_pace(len / ac->channels);
+
+		/* Append the slice to the ring buffer */
+		g_mutex_lock(&ring_mtx);
+		bytes = len * sizeof(int16_t);
+		off = ringhead % ringlen;
+		if (off + bytes <= ringlen) {
+			memcpy(ring + off, devbuf + done, bytes);
+		} else {
+			memcpy(ring + off, devbuf + done, ringlen - off);
+			memcpy(ring, (char *)(devbuf + done) + ringlen - off,
+			    bytes - (ringlen - off));
+		}
+		ringhead += bytes;
+		g_mutex_unlock(&ring_mtx);
+
+		audio_output_wakeup();
+	}
+
+	return (0);
+}
+
+void
+audio_output_flush(void)
+{
+	/* Audio that has been sent cannot be taken back */
+	pace_base = g_get_monotonic_time();
+	pace_frames = 0;
+}
+
+void
+audio_output_pause(int pause)
+{
+	/* Listeners simply stop receiving audio */
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	int64_t played;
+
+	if (cur_srate == 0)
+		return (0);
+
+	played = (g_get_monotonic_time() - pace_base) * cur_srate / 1000000;
+	return (played < pace_frames ? pace_frames - played : 0);
+}
+
+void
+audio_output_close(void)
+{
+	if (srv_thread == NULL)
+		return;
+
+	srv_quit = 1;
+	audio_output_wakeup();
+	g_thread_join(srv_thread);
+	srv_thread = NULL;
+
+	while (clients->len > 0)
+		audio_output_client_drop(clients->len - 1);
+	g_ptr_array_free(clients, TRUE);
+
+	close(srv_fd);
+	close(srv_wakeup[0]);
+	close(srv_wakeup[1]);
+	g_free(ring);
+}
@@ -30,7 +30,7 @@
 
 #include "stdinc.h"
 
-#include "audio_file.h"
+#include "audio_buffer.h"
 #include "audio_output.h"
 
 int
@@ -40,22 +40,42 @@ audio_output_open(void)
 }
 
 int
-audio_output_play(struct audio_file *fd)
+audio_output_play(const struct audio_chunk *ac)
 {
-	int16_t buf[4096];
-	size_t len;
 	unsigned long delay;
+	size_t len, done;
 
-	if ((len = audio_file_read(fd, buf, sizeof buf / sizeof(int16_t))) == 0)
-		return (-1);
+	for (done = 0; done < ac->len; done += len) {
+		/* The chunk has been flushed while playing it */
+		if (audio_buffer_stale(ac))
+			break;
 
-	/* This should just fit - 2^12 * 10^6 < 2^32 */
-	delay = (1000000 * len) / (fd->srate * fd->channels);
-	g_usleep(delay);
+		len = MIN(ac->len - done, AUDIO_OUTPUT_SLICE * ac->channels);
+		/* This should just fit - 2^12 * 10^6 < 2^32 */
+		delay = (1000000 * len) / (ac->srate * ac->channels);
+		g_usleep(delay);
+	}
 
 	return (0);
 }
 
+void
+audio_output_flush(void)
+{
+}
+
+void
+audio_output_pause(int pause)
+{
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	/* Playback is simulated synchronously */
+	return (0);
+}
+
 void
 audio_output_close(void)
 {
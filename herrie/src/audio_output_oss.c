@@ -31,9 +31,11 @@
 #include "stdinc.h"
 
 #include <sys/ioctl.h>
+#include <poll.h>
 #include OSS_HEADER
 
-#include "audio_file.h"
+#include "audio_buffer.h"
+#include "audio_dsp.h"
 #include "audio_output.h"
 #include "config.h"
 #include "gui.h"
@@ -42,6 +44,51 @@
 #define BUILD_OSS3_MIXER
 #endif /* !SNDCTL_DSP_GETPLAYVOL */
 
+/**
+ * @brief Sample format of the audio device.
+ */
+struct audio_output_format {
+	/**
+	 * @brief Name used in the configuration file.
+	 */
+	const char	*name;
+	/**
+	 * @brief Sample format used by OSS.
+	 */
+	int		format;
+	/**
+	 * @brief Amount of significant bits of an integer sample, or zero
+	 *        for floating point samples.
+	 */
+	unsigned int	bits;
+	/**
+	 * @brief Size of a single sample in bytes.
+	 */
+	size_t		size;
+};
+
+/**
+ * @brief Available sample formats, most precise first. 24 bits samples
+ *        are not used, as implementations disagree on their layout.
+ */
+static const struct audio_output_format formats[] = {
+#ifdef AFMT_FLOAT
+	{ "float",	AFMT_FLOAT,	0,	sizeof(float) },
+#endif /* AFMT_FLOAT */
+#ifdef AFMT_S32_NE
+	{ "s32",	AFMT_S32_NE,	32,	sizeof(int32_t) },
+#endif /* AFMT_S32_NE */
+	{ "s16",	AFMT_S16_NE,	16,	sizeof(int16_t) },
+};
+/**
+ * @brief Sample format that is requested, or NULL to pick the most
+ *        precise format the audio device supports.
+ */
+static const struct audio_output_format *reqfmt = NULL;
+/**
+ * @brief Sample format of the audio device handle.
+ */
+static const struct audio_output_format *devfmt = &formats[0];
 /**
  * @brief File descriptor of the audio device handle.
  */
@@ -60,11 +107,27 @@ static unsigned int cur_srate = 0;
  * @brief Amount of channels of the audio device handle.
  */
 static unsigned int cur_channels = 0;
+/**
+ * @brief Maximum amount of bytes queued in the audio device, or zero
+ *        when the whole device buffer may be filled.
+ */
+static int cur_target = 0;
+/**
+ * @brief Samples of the chunk that is being played, converted to the
+ *        format of the audio device.
+ */
+static int32_t devbuf[AUDIO_CHUNK_LEN];
 
 int
 audio_output_open(void)
 {
 	const char *dev;
+	unsigned int i;
+
+	dev = config_getopt("audio.output.oss.format");
+	for (i = 0; i < G_N_ELEMENTS(formats); i++)
+		if (strcmp(formats[i].name, dev) == 0)
+			reqfmt = &formats[i];
 
 	/* Open the audio device */
 	dev = config_getopt("audio.output.oss.device");
@@ -82,41 +145,173 @@ audio_output_open(void)
 	return (0);
 }
 
-int
-audio_output_play(struct audio_file *fd)
+/**
+ * @brief Apply the fragment settings from the configuration file to
+ *        the audio device.
+ */
+static void
+audio_output_setfragment(void)
 {
-	int16_t buf[2048];
-	int len;
+	int size, frags, arg;
+
+	size = config_getopt_number("audio.output.oss.fragment_size");
+	if (size <= 0)
+		return;
+	frags = config_getopt_number("audio.output.oss.fragments");
+	if (frags <= 0 || frags > 0x7fff)
+		frags = 0x7fff;
+
+	/* Fragment count in the top half, size selector in the bottom */
+	arg = (frags << 16) | (g_bit_storage(size) - 1);
+	ioctl(dev_fd, SNDCTL_DSP_SETFRAGMENT, &arg);
+}
+
+/**
+ * @brief Select the most precise sample format that is supported by
+ *        the audio device, or the one that has been requested.
+ */
+static int
+audio_output_setformat(void)
+{
+	unsigned int i;
 	int fmt;
 
-	if ((len = audio_file_read(fd, buf, sizeof buf / sizeof(int16_t))) == 0)
-		return (-1);
+	for (i = 0; i < G_N_ELEMENTS(formats); i++) {
+		if (reqfmt != NULL && reqfmt != &formats[i])
+			continue;
+		/* The device may substitute a format it prefers */
+		fmt = formats[i].format;
+		if (ioctl(dev_fd, SNDCTL_DSP_SETFMT, &fmt) != -1 &&
+		    fmt == formats[i].format) {
+			devfmt = &formats[i];
+			return (0);
+		}
+	}
 
-	if (cur_srate != fd->srate || cur_channels != fd->channels) {
-		/* Our settings have been altered */
-		ioctl(dev_fd, SNDCTL_DSP_RESET, NULL);
+	return (-1);
+}
 
-		/* 16 bits native endian stereo */
-		fmt = AFMT_S16_NE;
-		if (ioctl(dev_fd, SNDCTL_DSP_SETFMT, &fmt) == -1)
+/**
+ * @brief Wait until the audio device can accept at least one fragment
+ *        without exceeding the target fill level. Returns the amount of
+ *        bytes that can be written, zero when the chunk has been
+ *        flushed or -1 on failure.
+ */
+static int
+audio_output_space(const struct audio_chunk *ac)
+{
+	audio_buf_info info;
+	struct pollfd pfd[2];
+	int space, target, delay, fd, nfds, timeout;
+	int framesize;
+
+	framesize = ac->channels * devfmt->size;
+
+	for (;;) {
+		/* Obtain the descriptor before checking for flushes */
+		fd = audio_buffer_flush_fd();
+		if (audio_buffer_stale(ac))
+			return (0);
+
+		if (ioctl(dev_fd, SNDCTL_DSP_GETOSPACE, &info) == -1)
+			return (-1);
+		space = info.bytes;
+		nfds = 0;
+		timeout = -1;
+
+		if (cur_target != 0 &&
+		    ioctl(dev_fd, SNDCTL_DSP_GETODELAY, &delay) != -1) {
+			/* Never write less than a fragment at a time */
+			target = MAX(cur_target, 2 * info.fragsize);
+			if (target - delay < space) {
+				space = target - delay;
+				/* Sleep until a fragment has been played */
+				timeout = (info.fragsize - space) * 1000 /
+				    (int)(cur_srate * framesize) + 1;
+			}
+		}
+
+		space -= space % framesize;
+		if (space >= info.fragsize)
+			return (space);
+
+		if (fd != -1) {
+			pfd[nfds].fd = fd;
+			pfd[nfds].events = POLLIN;
+			pfd[nfds++].revents = 0;
+		}
+		if (timeout == -1) {
+			/* Wait for the device to drain a fragment */
+			pfd[nfds].fd = dev_fd;
+			pfd[nfds].events = POLLOUT;
+			pfd[nfds++].revents = 0;
+		}
+
+		if (poll(pfd, nfds, timeout) < 0 && errno != EINTR)
+			return (-1);
+	}
+}
+
+int
+audio_output_play(const struct audio_chunk *ac)
+{
+	size_t len, done;
+	const char *buf;
+	int space;
+	int srate, channels;
+
+	if (cur_srate != ac->srate || cur_channels != ac->channels) {
+		/* Play the queued samples before changing the settings */
+		ioctl(dev_fd, SNDCTL_DSP_SYNC, NULL);
+		audio_output_setfragment();
+
+		if (audio_output_setformat() != 0)
 			goto bad;
 
 		/* Reset the sample rate */
-		if (ioctl(dev_fd, SNDCTL_DSP_SPEED, &fd->srate) == -1)
+		srate = ac->srate;
+		if (ioctl(dev_fd, SNDCTL_DSP_SPEED, &srate) == -1)
 			goto bad;
 
 		/* Reset the number of channels rate */
-		if (ioctl(dev_fd, SNDCTL_DSP_CHANNELS, &fd->channels) == -1)
+		channels = ac->channels;
+		if (ioctl(dev_fd, SNDCTL_DSP_CHANNELS, &channels) == -1)
 			goto bad;
 
 		/* Both succeeded */
-		cur_srate = fd->srate;
-		cur_channels = fd->channels;
+		cur_srate = ac->srate;
+		cur_channels = ac->channels;
+		cur_target = (uint64_t)config_getopt_number(
+		    "audio.output.oss.buffer_time") * cur_srate / 1000000 *
+		    cur_channels * devfmt->size;
 	}
 
-	len *= sizeof(int16_t);
-	if (write(dev_fd, buf, len) != len)
-		return (-1);
+	if (devfmt->bits == 0) {
+		/* Floating point samples are passed through unaltered */
+		buf = (const char *)ac->buf;
+	} else {
+		if (devfmt->bits == 16)
+			audio_dsp_to_s16((int16_t *)devbuf, ac->buf, ac->len);
+		else
+			audio_dsp_to_s32(devbuf, ac->buf, ac->len,
+			    devfmt->bits);
+		buf = (const char *)devbuf;
+	}
+
+	for (done = 0; done < ac->len; done += len) {
+		/* Write as much as the device can take at once */
+		space = audio_output_space(ac);
+		if (space == 0)
+			/* The chunk has been flushed while writing it */
+			break;
+		else if (space < 0)
+			return (-1);
+
+		len = MIN(ac->len - done, space / devfmt->size);
+		if (write(dev_fd, buf + done * devfmt->size,
+		    len * devfmt->size) != (ssize_t)(len * devfmt->size))
+			return (-1);
+	}
 
 	return (0);
 bad:
@@ -126,6 +321,31 @@ bad:
 	return (-1);
 }
 
+void
+audio_output_flush(void)
+{
+	ioctl(dev_fd, SNDCTL_DSP_RESET, NULL);
+	/* Some implementations forget the settings after a reset */
+	cur_srate = 0;
+}
+
+void
+audio_output_pause(int pause)
+{
+	/* OSS has no portable way to pause playback */
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	int delay;
+
+	if (cur_channels == 0 ||
+	    ioctl(dev_fd, SNDCTL_DSP_GETODELAY, &delay) == -1 || delay < 0)
+		return (0);
+	return (delay / (cur_channels * devfmt->size));
+}
+
 void
 audio_output_close(void)
 {
@@ -32,7 +32,8 @@
 
 #include <pulse/simple.h>
 
-#include "audio_file.h"
+#include "audio_buffer.h"
+#include "audio_dsp.h"
 #include "audio_output.h"
 #include "gui.h"
 
@@ -44,6 +45,11 @@ static pa_simple*	devptr = NULL;
  * @brief Format of the current open audio device handle.
  */
 static pa_sample_spec	devfmt = { PA_SAMPLE_S16LE, 0, 0 };
+/**
+ * @brief Samples of the chunk that is being played, converted to the
+ *        format of the audio device.
+ */
+static int16_t		devbuf[AUDIO_CHUNK_LEN];
 
 int
 audio_output_open(void)
@@ -52,20 +58,16 @@ audio_output_open(void)
 }
 
 int
-audio_output_play(struct audio_file *fd)
+audio_output_play(const struct audio_chunk *ac)
 {
-	int16_t buf[2048];
-	size_t len;
-
-	if ((len = audio_file_read(fd, buf, sizeof buf / sizeof(int16_t))) == 0)
-		return (-1);
+	size_t len, done;
 
-	if (devfmt.rate != fd->srate || devfmt.channels != fd->channels) {
+	if (devfmt.rate != ac->srate || devfmt.channels != ac->channels) {
 		/* Sample rate or amount of channels has changed */
 		audio_output_close();
 
-		devfmt.rate = fd->srate;
-		devfmt.channels = fd->channels;
+		devfmt.rate = ac->srate;
+		devfmt.channels = ac->channels;
 	}
 
 	if (devptr == NULL) {
@@ -79,15 +81,49 @@ audio_output_play(struct audio_file *fd)
 		}
 	}
 
-	if (pa_simple_write(devptr, buf, len * sizeof(int16_t), NULL) != 0) {
-		/* No success - device must be closed */
-		audio_output_close();
-		return (-1);
+	audio_dsp_to_s16(devbuf, ac->buf, ac->len);
+
+	for (done = 0; done < ac->len; done += len) {
+		/* The chunk has been flushed while writing it */
+		if (audio_buffer_stale(ac))
+			break;
+
+		len = MIN(ac->len - done, AUDIO_OUTPUT_SLICE * ac->channels);
+		if (pa_simple_write(devptr, devbuf + done,
+		    len * sizeof(int16_t), NULL) != 0) {
+			/* No success - device must be closed */
+			audio_output_close();
+			return (-1);
+		}
 	}
 
 	return (0);
 }
 
+void
+audio_output_flush(void)
+{
+	if (devptr != NULL)
+		pa_simple_flush(devptr, NULL);
+}
+
+void
+audio_output_pause(int pause)
+{
+	/* Not supported by the simple API */
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	pa_usec_t latency;
+
+	if (devptr == NULL ||
+	    (latency = pa_simple_get_latency(devptr, NULL)) == (pa_usec_t)-1)
+		return (0);
+	return (latency * devfmt.rate / 1000000);
+}
+
 void
 audio_output_close(void)
 {
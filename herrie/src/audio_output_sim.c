@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_output_sim.c
+ * @brief Simulated audio output driver, modelling the ring buffer of a
+ *        sound device to reproduce underruns.
+ */
+
+#include "stdinc.h"
+
+#include "audio_buffer.h"
+#include "audio_output.h"
+#include "config.h"
+#include "gui.h"
+
+/*
+ * The simulated device consumes its ring buffer one period at a time,
+ * following a virtual clock that counts frames. When a period is due
+ * and the buffer holds less than a period, an underrun occurs and the
+ * device stops until the buffer has been filled completely again.
+ *
+ * By default, the virtual clock advances while the audio output waits
+ * for room in the buffer, so playback does not depend on the speed of
+ * the machine and runs as fast as possible. The time the audio output
+ * spends waiting for the decoder between writes is added to the
+ * virtual clock as well, so a decoder that cannot keep up still causes
+ * underruns. Jitter and stalls are derived from a seeded random number
+ * generator, so runs with a decoder that keeps up are reproducible. In
+ * real-time mode, the virtual clock follows the system clock instead
+ * and the waits actually sleep.
+ */
+
+/**
+ * @brief Sample rate of the simulated device.
+ */
+static unsigned int	cur_srate = 0;
+/**
+ * @brief Amount of channels of the simulated device.
+ */
+static unsigned int	cur_channels = 0;
+/**
+ * @brief Size of the ring buffer in frames.
+ */
+static int64_t		sim_buffer;
+/**
+ * @brief Size of a period in frames.
+ */
+static int64_t		sim_period;
+/**
+ * @brief Amount of frames stored in the ring buffer.
+ */
+static int64_t		sim_fill;
+/**
+ * @brief Whether the device is consuming the ring buffer.
+ */
+static int		sim_running;
+/**
+ * @brief Virtual time of the device in frames.
+ */
+static int64_t		sim_clock;
+/**
+ * @brief Virtual time at which the next period is consumed.
+ */
+static int64_t		sim_next;
+/**
+ * @brief Virtual time at which the next stall occurs.
+ */
+static int64_t		sim_stall;
+/**
+ * @brief System time matching virtual time zero in real-time mode.
+ */
+static gint64		sim_base;
+/**
+ * @brief System time at which the last write returned, used to account
+ *        for the time the audio output waits for decoded audio.
+ */
+static gint64		sim_idle = 0;
+/**
+ * @brief Random number generator used for the jitter.
+ */
+static GRand		*sim_rand = NULL;
+/**
+ * @brief Amount of underruns that have occurred.
+ */
+static unsigned int	sim_xruns = 0;
+/**
+ * @brief Amount of frames consumed by the device.
+ */
+static int64_t		sim_played = 0;
+/**
+ * @brief Summary printed when the application exits.
+ */
+static char		*sim_summary = NULL;
+
+/**
+ * @brief Length of the ring buffer in microseconds.
+ */
+static unsigned int	buffer_time;
+/**
+ * @brief Length of a period in microseconds.
+ */
+static unsigned int	period_time;
+/**
+ * @brief Maximum delay added to every wakeup in microseconds.
+ */
+static unsigned int	jitter;
+/**
+ * @brief Interval between stalls in seconds, or zero when disabled.
+ */
+static unsigned int	stall_interval;
+/**
+ * @brief Duration of a stall in microseconds.
+ */
+static unsigned int	stall_time;
+/**
+ * @brief Whether the virtual clock follows the system clock.
+ */
+static int		realtime;
+
+/**
+ * @brief Convert microseconds to frames at the current sample rate.
+ */
+static int64_t
+audio_output_frames(unsigned int usec)
+{
+	return ((int64_t)usec * cur_srate / 1000000);
+}
+
+/**
+ * @brief Advance the virtual clock, letting the device consume a
+ *        period whenever one is due.
+ */
+static void
+audio_output_advance(int64_t frames)
+{
+	int64_t end;
+	char *msg;
+
+	end = sim_clock + frames;
+	while (sim_next <= end) {
+		if (!sim_running) {
+			/* Idle devices only keep track of time */
+			sim_next += ((end - sim_next) / sim_period + 1) *
+			    sim_period;
+			break;
+		}
+
+		sim_clock = sim_next;
+		sim_next += sim_period;
+		if (sim_fill < sim_period) {
+			/* Play what's left and stop */
+			sim_played += sim_fill;
+			sim_fill = 0;
+			sim_running = 0;
+			sim_xruns++;
+
+			msg = g_strdup_printf(_("Simulated underrun %u."),
+			    sim_xruns);
+			gui_msgbar_warn(msg);
+			g_free(msg);
+		} else {
+			sim_played += sim_period;
+			sim_fill -= sim_period;
+		}
+	}
+	sim_clock = end;
+}
+
+/**
+ * @brief Bring the virtual clock up to date with the system clock in
+ *        real-time mode.
+ */
+static void
+audio_output_sync(void)
+{
+	int64_t now;
+
+	if (realtime) {
+		now = (g_get_monotonic_time() - sim_base) * cur_srate /
+		    1000000;
+		if (now > sim_clock)
+			audio_output_advance(now - sim_clock);
+	}
+}
+
+/**
+ * @brief Let the audio output wait for a certain amount of frames, plus
+ *        a random amount of jitter.
+ */
+static void
+audio_output_sleep(int64_t frames)
+{
+	if (jitter != 0)
+		frames += audio_output_frames(
+		    g_rand_int_range(sim_rand, 0, jitter + 1));
+
+	if (realtime) {
+		g_usleep(frames * 1000000 / cur_srate);
+		audio_output_sync();
+	} else {
+		audio_output_advance(frames);
+	}
+}
+
+int
+audio_output_open(void)
+{
+	buffer_time = config_getopt_number("audio.output.sim.buffer_time");
+	period_time = config_getopt_number("audio.output.sim.period_time");
+	jitter = config_getopt_number("audio.output.sim.jitter");
+	stall_interval = config_getopt_number("audio.output.sim.stall_interval");
+	stall_time = config_getopt_number("audio.output.sim.stall_time");
+	realtime = config_getopt_bool("audio.output.sim.realtime");
+
+	sim_rand = g_rand_new_with_seed(
+	    config_getopt_number("audio.output.sim.seed"));
+
+	return (0);
+}
+
+int
+audio_output_play(const struct audio_chunk *ac)
+{
+	int64_t len, done, frames, room;
+
+	if (cur_srate != ac->srate || cur_channels != ac->channels) {
+		/* Start with an empty device */
+		cur_srate = ac->srate;
+		cur_channels = ac->channels;
+
+		sim_period = MAX(audio_output_frames(period_time), 1);
+		sim_buffer = MAX(audio_output_frames(buffer_time),
+		    2 * sim_period);
+		sim_fill = 0;
+		sim_running = 0;
+		sim_clock = 0;
+		sim_next = sim_period;
+		sim_stall = (int64_t)stall_interval * cur_srate;
+		sim_base = g_get_monotonic_time();
+		sim_idle = 0;
+	}
+
+	if (!realtime && sim_idle != 0) {
+		/* The device kept playing while we waited for audio */
+		audio_output_advance((g_get_monotonic_time() - sim_idle) *
+		    cur_srate / 1000000);
+	}
+
+	frames = ac->len / ac->channels;
+	for (done = 0; done < frames; done += len) {
+		/* The chunk has been flushed while playing it */
+		if (audio_buffer_stale(ac))
+			break;
+
+		audio_output_sync();
+		if (stall_interval != 0 && sim_clock >= sim_stall) {
+			/* The audio output doesn't get to run for a while */
+			sim_stall += (int64_t)stall_interval * cur_srate;
+			audio_output_sleep(audio_output_frames(stall_time));
+		}
+
+		/* Start the device as soon as the buffer is full */
+		if (sim_fill >= sim_buffer)
+			sim_running = 1;
+
+		room = sim_buffer - sim_fill;
+		if (room == 0) {
+			/* Wait for the next period to be consumed */
+			audio_output_sleep(sim_next - sim_clock);
+			len = 0;
+			continue;
+		}
+
+		len = MIN(frames - done, MIN(room, AUDIO_OUTPUT_SLICE));
+		sim_fill += len;
+	}
+
+	if (!realtime)
+		sim_idle = g_get_monotonic_time();
+	return (0);
+}
+
+void
+audio_output_flush(void)
+{
+	sim_fill = 0;
+	sim_running = 0;
+}
+
+void
+audio_output_pause(int pause)
+{
+	if (cur_srate == 0)
+		return;
+
+	audio_output_sync();
+	/* Resuming restarts the device once the buffer is full */
+	if (pause)
+		sim_running = 0;
+}
+
+unsigned int
+audio_output_delay(void)
+{
+	return (sim_fill);
+}
+
+/**
+ * @brief Print the statistics of the simulation after the user
+ *        interface has been torn down.
+ */
+static void
+audio_output_atexit(void)
+{
+	g_printerr("%s\n", sim_summary);
+}
+
+void
+audio_output_close(void)
+{
+	if (sim_rand == NULL)
+		return;
+
+	g_rand_free(sim_rand);
+	sim_rand = NULL;
+
+	sim_summary = g_strdup_printf(
+	    _("Simulated device: %u underruns, %lld frames played."),
+	    sim_xruns, (long long)sim_played);
+	atexit(audio_output_atexit);
+}
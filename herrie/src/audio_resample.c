@@ -0,0 +1,330 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_resample.c
+ * @brief Polyphase sample rate converter.
+ */
+
+#include "stdinc.h"
+
+#include <math.h>
+
+#include "audio_dsp.h"
+#include "audio_resample.h"
+#include "config.h"
+
+/**
+ * @brief Parameters of the filter used by a quality preset.
+ */
+struct audio_resample_preset {
+	/**
+	 * @brief Name used in the configuration file.
+	 */
+	const char	*name;
+	/**
+	 * @brief Length of the filter in input samples. Must be a
+	 *        multiple of eight to allow vectorization.
+	 */
+	unsigned int	taps;
+	/**
+	 * @brief Amount of fractional positions for which filter
+	 *        coefficients are stored. Positions in between are
+	 *        interpolated linearly.
+	 */
+	unsigned int	phases;
+	/**
+	 * @brief Cutoff frequency, relative to the lowest of the two
+	 *        Nyquist frequencies.
+	 */
+	double		cutoff;
+	/**
+	 * @brief Shape parameter of the Kaiser window, trading stopband
+	 *        attenuation for transition bandwidth.
+	 */
+	double		beta;
+};
+
+/**
+ * @brief Available quality presets.
+ */
+static const struct audio_resample_preset rs_presets[] = {
+	{ "low",	16,	64,	0.85,	5.0 },
+	{ "medium",	32,	256,	0.91,	7.0 },
+	{ "high",	64,	1024,	0.95,	9.0 },
+};
+/**
+ * @brief Quality preset that is in use.
+ */
+static const struct audio_resample_preset *rs_preset = &rs_presets[1];
+
+/**
+ * @brief Amount of frames that are buffered per channel beyond the
+ *        length of the filter.
+ */
+#define RS_BLOCK	1024
+
+/**
+ * @brief Amount of channels of the audio.
+ */
+static unsigned int	rs_channels = 0;
+/**
+ * @brief Sample rate of the audio that is converted.
+ */
+static unsigned int	rs_irate = 0;
+/**
+ * @brief Sample rate the audio is converted to.
+ */
+static unsigned int	rs_orate = 0;
+/**
+ * @brief Filter coefficients of all phases, including an extra phase
+ *        to interpolate the last phase with.
+ */
+static float		*rs_filter = NULL;
+/**
+ * @brief Coefficients interpolated for the current output frame.
+ */
+static float		*rs_coef = NULL;
+/**
+ * @brief History of input samples, stored per channel, to allow
+ *        vectorized filtering.
+ */
+static float		*rs_hist = NULL;
+/**
+ * @brief Length of the history of each channel.
+ */
+static size_t		rs_histlen;
+/**
+ * @brief Amount of frames stored in the history.
+ */
+static size_t		rs_fill;
+/**
+ * @brief Position of the next output frame in the history, in 32.32
+ *        fixed point.
+ */
+static uint64_t		rs_pos;
+/**
+ * @brief Distance between output frames, in 32.32 fixed point.
+ */
+static uint64_t		rs_step;
+
+/**
+ * @brief Zeroth order modified Bessel function of the first kind, used
+ *        to compute the Kaiser window.
+ */
+static double
+audio_resample_bessel(double x)
+{
+	double sum = 1.0, term = 1.0;
+	unsigned int k;
+
+	for (k = 1; term > sum * 1e-12; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+
+	return (sum);
+}
+
+/**
+ * @brief Compute the windowed sinc coefficients of all phases.
+ */
+static void
+audio_resample_build(void)
+{
+	unsigned int half, p, k, taps = rs_preset->taps;
+	double fc, d, x, v, sum, norm;
+	float *coef;
+
+	/* Filter out everything the lowest of the two rates can't hold */
+	fc = rs_preset->cutoff * MIN(rs_orate, rs_irate) / rs_irate;
+	half = taps / 2;
+	norm = audio_resample_bessel(rs_preset->beta);
+
+	for (p = 0; p <= rs_preset->phases; p++) {
+		coef = rs_filter + p * taps;
+		sum = 0.0;
+		for (k = 0; k < taps; k++) {
+			/* Distance to the output frame in input samples */
+			d = (double)k - (half - 1) -
+			    (double)p / rs_preset->phases;
+			x = d / half;
+			v = d == 0.0 ? fc : sin(G_PI * fc * d) / (G_PI * d);
+			v *= audio_resample_bessel(rs_preset->beta *
+			    sqrt(MAX(1.0 - x * x, 0.0))) / norm;
+			coef[k] = v;
+			sum += v;
+		}
+
+		/* Don't alter the volume */
+		for (k = 0; k < taps; k++)
+			coef[k] /= sum;
+	}
+}
+
+/**
+ * @brief Return the number of the quality preset with a certain name,
+ *        or -1 when no such preset exists.
+ */
+static int
+audio_resample_preset(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < G_N_ELEMENTS(rs_presets); i++)
+		if (strcmp(rs_presets[i].name, name) == 0)
+			return (i);
+
+	return (-1);
+}
+
+void
+audio_resample_init(void)
+{
+	rs_preset = &rs_presets[audio_resample_preset(
+	    config_getopt("audio.resample.quality"))];
+}
+
+void
+audio_resample_setup(unsigned int channels, unsigned int irate,
+    unsigned int orate)
+{
+	unsigned int taps = rs_preset->taps;
+
+	if (channels == rs_channels && irate == rs_irate && orate == rs_orate)
+		return;
+
+	if (irate != rs_irate || orate != rs_orate) {
+		rs_irate = irate;
+		rs_orate = orate;
+		rs_step = ((uint64_t)irate << 32) / orate;
+		if (irate != orate) {
+			rs_filter = g_realloc(rs_filter,
+			    (rs_preset->phases + 1) * taps * sizeof(float));
+			audio_resample_build();
+		}
+	}
+
+	rs_channels = channels;
+	rs_histlen = taps + RS_BLOCK;
+	rs_hist = g_realloc(rs_hist, channels * rs_histlen * sizeof(float));
+	rs_coef = g_realloc(rs_coef, taps * sizeof(float));
+	audio_resample_reset();
+}
+
+void
+audio_resample_reset(void)
+{
+	unsigned int half = rs_preset->taps / 2;
+
+	/* Silence before the first frame */
+	if (rs_hist != NULL)
+		memset(rs_hist, 0, rs_channels * rs_histlen * sizeof(float));
+	rs_fill = half - 1;
+	rs_pos = (uint64_t)(half - 1) << 32;
+}
+
+/**
+ * @brief Append interleaved audio to the history, returning the amount
+ *        of frames that have been consumed.
+ */
+static size_t
+audio_resample_append(const float *src, size_t len)
+{
+	unsigned int half = rs_preset->taps / 2, c;
+	size_t i, shift;
+	float *h;
+
+	if (rs_fill == rs_histlen) {
+		/* Drop the samples no output frame depends on anymore */
+		shift = (rs_pos >> 32) - (half - 1);
+		for (c = 0; c < rs_channels; c++) {
+			h = rs_hist + c * rs_histlen;
+			memmove(h, h + shift,
+			    (rs_fill - shift) * sizeof(float));
+		}
+		rs_fill -= shift;
+		rs_pos -= (uint64_t)shift << 32;
+	}
+
+	len = MIN(len, rs_histlen - rs_fill);
+	for (c = 0; c < rs_channels; c++) {
+		h = rs_hist + c * rs_histlen + rs_fill;
+		for (i = 0; i < len; i++)
+			h[i] = src[i * rs_channels + c];
+	}
+	rs_fill += len;
+
+	return (len);
+}
+
+size_t
+audio_resample_run(float *dst, size_t olen, const float *src,
+    size_t *ilen)
+{
+	unsigned int taps = rs_preset->taps, half = taps / 2, c, k;
+	size_t n, done = 0, used = 0;
+	uint32_t frac;
+	const float *a, *b;
+	float f;
+
+	if (rs_irate == rs_orate) {
+		/* Nothing to convert */
+		*ilen = MIN(*ilen, olen);
+		memcpy(dst, src, *ilen * rs_channels * sizeof(float));
+		return (*ilen);
+	}
+
+	while (done < olen) {
+		n = rs_pos >> 32;
+		if (n + half >= rs_fill) {
+			/* The filter needs more input */
+			if (used == *ilen)
+				break;
+			used += audio_resample_append(src + used * rs_channels,
+			    *ilen - used);
+			continue;
+		}
+
+		/* Interpolate between the two nearest phases */
+		frac = (uint32_t)rs_pos;
+		k = ((uint64_t)frac * rs_preset->phases) >> 32;
+		f = (float)(((uint64_t)frac * rs_preset->phases) &
+		    0xffffffff) / 4294967296.0f;
+		a = rs_filter + k * taps;
+		b = a + taps;
+		for (k = 0; k < taps; k++)
+			rs_coef[k] = a[k] + (b[k] - a[k]) * f;
+
+		for (c = 0; c < rs_channels; c++)
+			*dst++ = audio_dsp_dot(rs_coef,
+			    rs_hist + c * rs_histlen + n - (half - 1), taps);
+		rs_pos += rs_step;
+		done++;
+	}
+
+	*ilen = used;
+	return (done);
+}
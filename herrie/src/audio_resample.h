@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_resample.h
+ * @brief Polyphase sample rate converter.
+ */
+
+/**
+ * @brief Select the quality preset from the configuration file.
+ */
+void audio_resample_init(void);
+/**
+ * @brief Prepare the resampler for converting audio with a certain
+ *        amount of channels from one sample rate to another. The
+ *        resampler is reset when the parameters differ from the ones
+ *        used previously.
+ */
+void audio_resample_setup(unsigned int channels, unsigned int irate,
+    unsigned int orate);
+/**
+ * @brief Discard the audio stored in the filter history, because the
+ *        next audio is not a continuation of the previous audio.
+ */
+void audio_resample_reset(void);
+/**
+ * @brief Convert interleaved audio. At most ilen frames are consumed
+ *        from src, while at most olen frames are stored in dst. The
+ *        amount of frames consumed is stored in ilen and the amount of
+ *        frames stored is returned.
+ */
+size_t audio_resample_run(float *dst, size_t olen, const float *src,
+    size_t *ilen);
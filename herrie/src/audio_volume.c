@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file audio_volume.c
+ * @brief Volume control, using either the mixer of the audio output or
+ *        a software gain stage.
+ */
+
+#include "stdinc.h"
+
+#include "audio_dsp.h"
+#include "audio_output.h"
+#include "audio_volume.h"
+#include "config.h"
+
+/**
+ * @brief Whether the volume is adjusted in software instead of using
+ *        the mixer of the audio output. It should only be used with
+ *        g_atomic_* operations.
+ */
+static volatile int	vol_software;
+/**
+ * @brief Volume set by the user in percent.
+ */
+static volatile int	vol_percent = 100;
+/**
+ * @brief Gain that was applied at the end of the previous buffer.
+ */
+static float		vol_gain = 1.0f;
+
+void
+audio_volume_init(void)
+{
+	g_atomic_int_set(&vol_software,
+	    config_getopt_bool("audio.volume.software"));
+}
+
+/**
+ * @brief Adjust the software volume by a certain percentage and return
+ *        the new value.
+ */
+static int
+audio_volume_adjust(int n)
+{
+	int vol;
+
+	vol = CLAMP(g_atomic_int_get(&vol_percent) + n, 0, 100);
+	g_atomic_int_set(&vol_percent, vol);
+	return (vol);
+}
+
+int
+audio_volume_up(void)
+{
+#ifdef BUILD_VOLUME
+	int vol;
+
+	if (!g_atomic_int_get(&vol_software)) {
+		if ((vol = audio_output_volume_up()) != -1)
+			return (vol);
+		/* No usable mixer - scale the audio instead */
+		g_atomic_int_set(&vol_software, 1);
+	}
+#endif /* BUILD_VOLUME */
+	return audio_volume_adjust(4);
+}
+
+int
+audio_volume_down(void)
+{
+#ifdef BUILD_VOLUME
+	int vol;
+
+	if (!g_atomic_int_get(&vol_software)) {
+		if ((vol = audio_output_volume_down()) != -1)
+			return (vol);
+		/* No usable mixer - scale the audio instead */
+		g_atomic_int_set(&vol_software, 1);
+	}
+#endif /* BUILD_VOLUME */
+	return audio_volume_adjust(-4);
+}
+
+void
+audio_volume_apply(float *buf, size_t len)
+{
+	float gain, pct;
+
+	if (!g_atomic_int_get(&vol_software) || len == 0)
+		return;
+
+	/* Cubic curve, approximating perceived loudness */
+	pct = g_atomic_int_get(&vol_percent) / 100.0f;
+	gain = pct * pct * pct;
+
+	/* Leave the audio alone at full volume */
+	if (gain == 1.0f && vol_gain == 1.0f)
+		return;
+
+	audio_dsp_gain(buf, len, vol_gain, gain);
+	vol_gain = gain;
+}
@@ -83,6 +83,113 @@ valid_percentage(char *val)
 	return (pct > 100 || end == NULL || *end != '\0');
 }
 
+/**
+ * @brief Determine if a numerical string is valid
+ */
+static int
+valid_number(char *val)
+{
+	char *end = NULL;
+
+	strtoul(val, &end, 10);
+	return (val[0] == '\0' || end == NULL || *end != '\0');
+}
+
+/**
+ * @brief Determine if an amount of output channels is valid
+ */
+static int
+valid_channels(char *val)
+{
+	unsigned long channels;
+	char *end = NULL;
+
+	channels = strtoul(val, &end, 10);
+	return (channels > 8 || val[0] == '\0' || end == NULL ||
+	    *end != '\0');
+}
+
+/**
+ * @brief Determine if an output sample rate is valid
+ */
+static int
+valid_rate(char *val)
+{
+	unsigned long rate;
+	char *end = NULL;
+
+	rate = strtoul(val, &end, 10);
+	return ((rate != 0 && (rate < 8000 || rate > 192000)) ||
+	    val[0] == '\0' || end == NULL || *end != '\0');
+}
+
+/**
+ * @brief Determine if a resampler quality string is valid
+ */
+static int
+valid_quality(char *val)
+{
+	return (strcmp(val, "low") != 0 && strcmp(val, "medium") != 0 &&
+	    strcmp(val, "high") != 0);
+}
+
+/**
+ * @brief Determine if a scheduling policy name is valid
+ */
+static int
+valid_sched_policy(char *val)
+{
+	return (strcmp(val, "other") != 0 &&
+	    strcmp(val, "fifo") != 0 &&
+	    strcmp(val, "rr") != 0);
+}
+
+/**
+ * @brief Determine if a niceness string is valid
+ */
+static int
+valid_nice(char *val)
+{
+	long nice;
+	char *end = NULL;
+
+	nice = strtol(val, &end, 10);
+	return (nice < -20 || nice > 19 || val[0] == '\0' || end == NULL ||
+	    *end != '\0');
+}
+
+/**
+ * @brief Determine if a list of processors is valid
+ */
+static int
+valid_cpus(char *val)
+{
+	return (val[strspn(val, "0123456789,-")] != '\0');
+}
+
+#if defined(BUILD_FILE) || defined(BUILD_HTTPD)
+/**
+ * @brief Determine if a PCM stream format name is valid
+ */
+static int
+valid_pcm_format(char *val)
+{
+	return (strcmp(val, "wav") != 0 && strcmp(val, "raw") != 0);
+}
+#endif /* BUILD_FILE || BUILD_HTTPD */
+
+#ifdef BUILD_OSS
+/**
+ * @brief Determine if an audio device sample format name is valid
+ */
+static int
+valid_sample_format(char *val)
+{
+	return (strcmp(val, "auto") != 0 && strcmp(val, "float") != 0 &&
+	    strcmp(val, "s32") != 0 && strcmp(val, "s16") != 0);
+}
+#endif /* BUILD_OSS */
+
 #ifdef BUILD_SCROBBLER
 /**
  * @brief Determine if a string containing an MD5 hash is valid
@@ -145,6 +252,7 @@ struct config_entry {
  * @brief List of configuration switches.
  */
 static struct config_entry configlist[] = {
+	{ "audio.buffer.size",		"1024",		valid_number,	NULL },
 #ifdef BUILD_ALSA
 	{ "audio.output.alsa.device",	"default",	NULL,		NULL },
 #ifdef BUILD_VOLUME
@@ -155,12 +263,46 @@ static struct config_entry configlist[] = {
 	{ "audio.output.ao.driver",	"",		NULL,		NULL },
 	{ "audio.output.ao.host",	"",		NULL,		NULL },
 #endif /* BUILD_AO */
+	{ "audio.output.channels",	"0",		valid_channels,	NULL },
+#ifdef BUILD_FILE
+	{ "audio.output.file.format",	"wav",		valid_pcm_format, NULL },
+	{ "audio.output.file.path",	"-",		NULL,		NULL },
+#endif /* BUILD_FILE */
+#ifdef BUILD_HTTPD
+	{ "audio.output.httpd.address",	"",		NULL,		NULL },
+	{ "audio.output.httpd.buffer_time", "2000000",	valid_number,	NULL },
+	{ "audio.output.httpd.clients",	"16",		valid_number,	NULL },
+	{ "audio.output.httpd.format",	"wav",		valid_pcm_format, NULL },
+	{ "audio.output.httpd.port",	"8000",		valid_number,	NULL },
+#endif /* BUILD_HTTPD */
 #ifdef BUILD_OSS
+	{ "audio.output.oss.buffer_time", "0",		valid_number,	NULL },
 	{ "audio.output.oss.device",	OSS_DEVICE,	NULL,		NULL },
+	{ "audio.output.oss.format",	"auto",		valid_sample_format, NULL },
+	{ "audio.output.oss.fragment_size", "0",	valid_number,	NULL },
+	{ "audio.output.oss.fragments",	"0",		valid_number,	NULL },
 #ifdef BUILD_VOLUME
 	{ "audio.output.oss.mixer",	"/dev/mixer",	NULL,		NULL },
 #endif /* BUILD_VOLUME */
 #endif /* BUILD_OSS */
+#ifdef BUILD_PULSE
+#endif /* BUILD_PULSE */
+	{ "audio.output.rate",		"0",		valid_rate,	NULL },
+#ifdef BUILD_SIM
+	{ "audio.output.sim.buffer_time", "100000",	valid_number,	NULL },
+	{ "audio.output.sim.jitter",	"0",		valid_number,	NULL },
+	{ "audio.output.sim.period_time", "25000",	valid_number,	NULL },
+	{ "audio.output.sim.realtime",	"no",		valid_bool,	NULL },
+	{ "audio.output.sim.seed",	"0",		valid_number,	NULL },
+	{ "audio.output.sim.stall_interval", "0",	valid_number,	NULL },
+	{ "audio.output.sim.stall_time", "50000",	valid_number,	NULL },
+#endif /* BUILD_SIM */
+	{ "audio.resample.quality",	"medium",	valid_quality,	NULL },
+#ifdef BUILD_VOLUME
+	{ "audio.volume.software",	"no",		valid_bool,	NULL },
+#else /* !BUILD_VOLUME */
+	{ "audio.volume.software",	"yes",		valid_bool,	NULL },
+#endif /* BUILD_VOLUME */
 	{ "gui.browser.defaultpath",	"",		NULL,		NULL },
 	{ "gui.color.bar.bg",		"blue",		valid_color,	NULL },
 	{ "gui.color.bar.fg",		"white",	valid_color,	NULL },
@@ -175,10 +317,19 @@ static struct config_entry configlist[] = {
 	{ "gui.color.select.fg",	"black",	valid_color,	NULL },
 	{ "gui.input.confirm",		"yes",		valid_bool,	NULL },
 	{ "gui.input.may_quit",		"yes",		valid_bool,	NULL },
+	{ "gui.playq.showbuffer",	"no",		valid_bool,	NULL },
 	{ "gui.ratio",			"50",		valid_percentage, NULL },
 	{ "gui.vfslist.scrollpages",	"no",		valid_bool,	NULL },
 	{ "playq.autoplay",		"no",		valid_bool,	NULL },
+	{ "playq.crossfade",		"0",		valid_number,	NULL },
 	{ "playq.dumpfile",		CONFHOMEDIR PLAYQ_DUMPFILE, NULL, NULL },
+	{ "playq.readahead.count",	"2",		valid_number,	NULL },
+	{ "playq.readahead.size",	"65536",	valid_number,	NULL },
+	{ "playq.sched.cpus",		"",		valid_cpus,	NULL },
+	{ "playq.sched.mlock",		"no",		valid_bool,	NULL },
+	{ "playq.sched.nice",		"0",		valid_nice,	NULL },
+	{ "playq.sched.policy",		"other",	valid_sched_policy, NULL },
+	{ "playq.sched.priority",	"10",		valid_number,	NULL },
 	{ "playq.xmms",			"no",		valid_bool,	NULL },
 #ifdef BUILD_SCROBBLER
 	{ "scrobbler.dumpfile",		CONFHOMEDIR "scrobbler.queue", NULL, NULL },
@@ -320,3 +471,9 @@ config_getopt_percentage(const char *val)
 {
 	return strtoul(config_getopt(val), NULL, 10);
 }
+
+unsigned int
+config_getopt_number(const char *val)
+{
+	return strtoul(config_getopt(val), NULL, 10);
+}
@@ -49,3 +49,7 @@ int		config_getopt_color(const char *val);
  * @brief Return a value translated to a percentage
  */
 int		config_getopt_percentage(const char *val);
+/**
+ * @brief Return a value translated to an unsigned number
+ */
+unsigned int	config_getopt_number(const char *val);
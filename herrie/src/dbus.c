@@ -151,11 +151,9 @@ dbus_server_stop(DBusServer *self, GError **error)
 static gboolean
 dbus_server_volume_down(DBusServer *self, GError **error)
 {
-#ifdef BUILD_VOLUME
 	dbus_lock();
 	gui_playq_volume_down();
 	dbus_unlock();
-#endif /* BUILD_VOLUME */
 
 	return (TRUE);
 }
@@ -166,11 +164,9 @@ dbus_server_volume_down(DBusServer *self, GError **error)
 static gboolean
 dbus_server_volume_up(DBusServer *self, GError **error)
 {
-#ifdef BUILD_VOLUME
 	dbus_lock();
 	gui_playq_volume_up();
 	dbus_unlock();
-#endif /* BUILD_VOLUME */
 
 	return (TRUE);
 }
@@ -498,10 +498,8 @@ struct gui_binding {
  */
 static struct gui_binding kbdbindings[] = {
 	/* Application-wide keyboard bindings */
-#ifdef BUILD_VOLUME
 	{ -1, '(',			gui_playq_volume_down },
 	{ -1, ')',			gui_playq_volume_up },
-#endif /* BUILD_VOLUME */
 	{ -1, '<',			gui_input_cursong_seek_backward },
 	{ -1, '>',			gui_input_cursong_seek_forward },
 	{ -1, 'a',			gui_browser_playq_add_after },
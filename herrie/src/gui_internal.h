@@ -262,7 +262,6 @@ void gui_playq_setfocus(int focus);
  *        bar.
  */
 void gui_playq_fullpath(void);
-#ifdef BUILD_VOLUME
 /**
  * @brief Increment the volume and display the new value.
  */
@@ -271,7 +270,6 @@ void gui_playq_volume_up(void);
  * @brief Decrement the volume and display the new value.
  */
 void gui_playq_volume_down(void);
-#endif /* BUILD_VOLUME */
 /**
  * @brief Go to the directory containing the selected item.
  */
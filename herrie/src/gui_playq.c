@@ -30,8 +30,10 @@
 
 #include "stdinc.h"
 
+#include "audio_buffer.h"
 #include "audio_file.h"
-#include "audio_output.h"
+#include "audio_volume.h"
+#include "config.h"
 #include "gui.h"
 #include "gui_internal.h"
 #include "gui_vfslist.h"
@@ -52,6 +54,10 @@ static const char *str_status = NULL;
  *        title of the current song.
  */
 static GString *str_song;
+/**
+ * @brief Show the fill level of the audio buffer in the status bar.
+ */
+static int show_buffer;
 /**
  * @brief Window object of the status bar at the top of the screen.
  */
@@ -144,12 +150,18 @@ gui_playq_statbar_time(struct audio_file *fd)
 		g_string_assign(str_time, "");
 	} else {
 		g_string_assign(str_time, " [");
-		gui_playq_statbar_time_calc(str_time, fd->time_cur);
+		gui_playq_statbar_time_calc(str_time, fd->time_play);
 		if (!fd->stream) {
 			g_string_append_c(str_time, '/');
 			gui_playq_statbar_time_calc(str_time, fd->time_len);
 		}
 		g_string_append_c(str_time, ']');
+
+		if (show_buffer) {
+			/* Current and lowest fill level of the audio buffer */
+			g_string_append_printf(str_time, " [%u%%/%u%%]",
+			    audio_buffer_fill(), audio_buffer_fill_lowest());
+		}
 	}
 }
 
@@ -209,6 +221,7 @@ gui_playq_init(void)
 
 	str_time = g_string_sized_new(24);
 	str_song = g_string_sized_new(128);
+	show_buffer = config_getopt_bool("gui.playq.showbuffer");
 
 	gui_playq_song_set(NULL, 0, 0);
 
@@ -513,7 +526,6 @@ gui_playq_fullpath(void)
 	playq_unlock();
 }
 
-#ifdef BUILD_VOLUME
 /**
  * @brief Show the result of the volume setting routines.
  */
@@ -536,7 +548,7 @@ gui_playq_volume_up(void)
 {
 	int nval;
 
-	nval = audio_output_volume_up();
+	nval = audio_volume_up();
 	gui_playq_volume_show(nval);
 }
 
@@ -545,10 +557,9 @@ gui_playq_volume_down(void)
 {
 	int nval;
 
-	nval = audio_output_volume_down();
+	nval = audio_volume_down();
 	gui_playq_volume_show(nval);
 }
-#endif /* BUILD_VOLUME */
 
 void
 gui_playq_gotofolder(void)
@@ -30,12 +30,18 @@
 
 #include "stdinc.h"
 
+#include "audio_buffer.h"
+#include "audio_dsp.h"
 #include "audio_file.h"
 #include "audio_output.h"
+#include "audio_resample.h"
+#include "audio_volume.h"
 #include "config.h"
 #include "gui.h"
 #include "playq.h"
+#include "playq_cmd.h"
 #include "playq_modules.h"
+#include "playq_sched.h"
 #include "vfs.h"
 
 /**
@@ -46,6 +52,11 @@ struct playq_funcs {
 	 * @brief Give a song that should be played.
 	 */
 	struct vfsref *(*give)(void);
+	/**
+	 * @brief Return the song that give() is going to return next,
+	 *        without altering the playlist.
+	 */
+	struct vfsref *(*peek)(unsigned int idx);
 	/**
 	 * @brief Report that playback thread is going idle.
 	 */
@@ -73,6 +84,7 @@ struct playq_funcs {
  */
 static struct playq_funcs party_funcs = {
 	playq_party_give,
+	playq_party_peek,
 	playq_party_idle,
 	playq_party_select,
 	playq_party_next,
@@ -84,6 +96,7 @@ static struct playq_funcs party_funcs = {
  */
 static struct playq_funcs xmms_funcs = {
 	playq_xmms_give,
+	playq_xmms_peek,
 	playq_xmms_idle,
 	playq_xmms_select,
 	playq_xmms_next,
@@ -104,21 +117,26 @@ GMutex			playq_mtx;
  */
 static GCond		playq_wakeup;
 /**
- * @brief Reference to playback thread.
+ * @brief Reference to the decoding thread.
  */
 static GThread		*playq_runner;
 /**
- * @brief Randomizer used for shuffling the playlist.
+ * @brief Reference to the audio output thread.
  */
-static GRand		*playq_rand;
+static GThread		*playq_output;
 /**
- * @brief Quit the playback thread.
+ * @brief Reference to the thread that opens the next song in advance.
  */
-#define PF_QUIT		0x01
+static GThread		*playq_primer;
 /**
- * @brief Pause the current song.
+ * @brief Reference to the thread that reads upcoming songs into the
+ *        page cache.
  */
-#define PF_PAUSE	0x02
+static GThread		*playq_readahead;
+/**
+ * @brief Randomizer used for shuffling the playlist.
+ */
+static GRand		*playq_rand;
 /**
  * @brief Perform an absolute seek.
  */
@@ -140,35 +158,673 @@ static GRand		*playq_rand;
  */
 #define PF_STOP		0x40
 /**
- * @brief Flags the playback thread should honour. Writing to them
- *        should be locked down.
+ * @brief Flags the playback thread should honour. They are only
+ *        modified by the decoding thread, based on the commands it
+ *        receives through the command queue.
  */
 static volatile int	playq_flags = PF_STOP;
+/**
+ * @brief Pause the current song. It is toggled by the thread that
+ *        requests it and read by the audio output thread, so pausing
+ *        works even when the decoder is blocked. Should only be used
+ *        with g_atomic_* operations.
+ */
+static int		playq_paused = 0;
+/**
+ * @brief Shut down all playback threads.
+ */
+static volatile int	playq_quit = 0;
 int			playq_repeat = 0;
 /**
  * @brief Amount of seconds which the current song should seek.
  */
-static volatile int	playq_seek_time;
+static int		playq_seek_time;
+/**
+ * @brief The song that is currently being decoded.
+ */
+static struct audio_file *playq_decoding = NULL;
+/**
+ * @brief Lock protecting the audible position of the songs, which is
+ *        stored by the audio output thread.
+ */
+static GMutex		playq_pos_mtx;
+
+/**
+ * @brief Amount of seconds before the end of the current song at which
+ *        the next song is opened.
+ */
+#define PLAYQ_PRIME_TIME	10
+/**
+ * @brief Amount of chunks the primer decodes in advance.
+ */
+#define PLAYQ_PRIME_CHUNKS	4
+/**
+ * @brief Conditional variable used to notify the primer of new work and
+ *        the decoder of its completion.
+ */
+static GCond		playq_prime_wakeup;
+/**
+ * @brief Song that is being primed or has been primed.
+ */
+static struct vfsref	*playq_prime_vr = NULL;
+/**
+ * @brief The primed song, or NULL when it could not be opened.
+ */
+static struct audio_file *playq_prime_fd = NULL;
+/**
+ * @brief Audio decoded by the primer.
+ */
+static struct audio_chunk playq_prime_buf[PLAYQ_PRIME_CHUNKS];
+/**
+ * @brief Amount of chunks in playq_prime_buf that are filled.
+ */
+static unsigned int	playq_prime_len;
+/**
+ * @brief Whether the primer is still working on playq_prime_vr.
+ */
+static int		playq_prime_busy = 0;
+/**
+ * @brief Song taken from the primer of which the decoder hasn't
+ *        consumed all primed chunks yet.
+ */
+static struct audio_file *playq_primed_fd = NULL;
+/**
+ * @brief Index of the next primed chunk the decoder should consume.
+ */
+static unsigned int	playq_prime_idx;
+/**
+ * @brief Amount of samples of the current primed chunk that have been
+ *        consumed.
+ */
+static size_t		playq_prime_off;
+
+/**
+ * @brief Amount of seconds the songs should overlap, or zero when
+ *        crossfading is disabled.
+ */
+static unsigned int	playq_xfade;
+/**
+ * @brief Song that is faded in. It is only taken from the playlist once
+ *        it becomes the current song, so skipping or stopping during
+ *        the fade doesn't lose it.
+ */
+static struct vfsref	*playq_xfade_vr = NULL;
+/**
+ * @brief Audio of the song that is faded in, as decoded.
+ */
+static float		playq_xfade_raw[AUDIO_CHUNK_LEN];
+/**
+ * @brief Audio of the song that is faded in, converted to the amount of
+ *        channels of the song that is faded out.
+ */
+static float		playq_xfade_buf[AUDIO_CHUNK_LEN];
+
+/**
+ * @brief Sample rate the audio output is fixed to, or zero when the
+ *        audio output follows the sample rate of the songs.
+ */
+static unsigned int	playq_out_srate;
+/**
+ * @brief Amount of channels the audio output is fixed to, or zero when
+ *        the audio output follows the songs.
+ */
+static unsigned int	playq_out_channels;
+/**
+ * @brief Audio converted to the amount of channels of the audio output.
+ */
+static float		playq_out_raw[AUDIO_CHUNK_LEN];
+/**
+ * @brief Audio converted to the format of the audio output.
+ */
+static struct audio_chunk playq_out_chunk;
+
+/**
+ * @brief Send a command to the decoding thread.
+ */
+static void
+playq_cmd_send(int type, int seek)
+{
+	/* Skipping, stopping and starting unpause playback */
+	if (type == PLAYQ_CMD_SKIP || type == PLAYQ_CMD_STOP ||
+	    type == PLAYQ_CMD_START)
+		g_atomic_int_set(&playq_paused, 0);
+
+	if (playq_cmd_push(type, seek, NULL) != 0) {
+		gui_msgbar_warn(_("Too many pending playback commands."));
+		return;
+	}
+
+	/* Wake up the decoder when it's waiting for buffer space */
+	audio_buffer_wakeup();
+}
+
+/**
+ * @brief Process the commands in the command queue, updating the
+ *        playback flags. Consecutive seeks are coalesced. Only the
+ *        decoding thread may call this function.
+ */
+static void
+playq_cmd_poll(void)
+{
+	struct playq_cmd cmd;
+	int fl = playq_flags;
+
+	while (playq_cmd_pop(&cmd) == 0) {
+		switch (cmd.type) {
+		case PLAYQ_CMD_SEEK_ABS:
+			fl = (fl & ~PF_SEEK) | PF_SEEK_ABS;
+			playq_seek_time = cmd.seek;
+			break;
+		case PLAYQ_CMD_SEEK_REL:
+			if (fl & PF_SEEK) {
+				/* Add it to the pending seek */
+				playq_seek_time += cmd.seek;
+			} else {
+				fl |= PF_SEEK_REL;
+				playq_seek_time = cmd.seek;
+			}
+			break;
+		case PLAYQ_CMD_SKIP:
+			fl = (fl | PF_SKIP) & ~PF_SEEK;
+			break;
+		case PLAYQ_CMD_SKIP_FILE:
+			/* Audio output failed - song is useless */
+			if (cmd.fd == playq_decoding)
+				fl = (fl | PF_SKIP) & ~PF_SEEK;
+			break;
+		case PLAYQ_CMD_STOP:
+			fl = (fl | PF_SKIP|PF_STOP) & ~PF_SEEK;
+			break;
+		case PLAYQ_CMD_START:
+			fl = (fl | PF_SKIP) & ~(PF_STOP|PF_SEEK);
+			break;
+		}
+	}
+
+	playq_flags = fl;
+}
+
+/**
+ * @brief Wait until a chunk in the audio buffer becomes available for
+ *        decoding. Returns NULL when one of the flags in mask is set.
+ */
+static struct audio_chunk *
+playq_buffer_get(int mask)
+{
+	struct audio_chunk *ac;
+	unsigned int ev;
+
+	for (;;) {
+		ev = audio_buffer_events();
+		playq_cmd_poll();
+		if (playq_quit || playq_flags & mask)
+			return (NULL);
+		if ((ac = audio_buffer_write_begin()) != NULL)
+			return (ac);
+		audio_buffer_wait(ev);
+	}
+}
+
+/**
+ * @brief Notify the audio output thread that playback of a new song
+ *        starts, or that playback stops when fd is NULL.
+ */
+static void
+playq_buffer_marker(struct audio_file *fd)
+{
+	struct audio_chunk *ac;
+
+	if ((ac = playq_buffer_get(0)) == NULL)
+		return;
+
+	ac->fd = fd != NULL ? audio_file_ref(fd) : NULL;
+	ac->len = 0;
+	audio_buffer_write_end();
+}
+
+/**
+ * @brief Amount of songs that should be read in advance.
+ */
+static unsigned int	playq_readahead_count;
+/**
+ * @brief Maximum amount of bytes that should be read in advance.
+ */
+static off_t		playq_readahead_size;
+/**
+ * @brief Generation number of the playlist, incremented each time the
+ *        upcoming songs may have changed. It should only be modified
+ *        with the playlist locked.
+ */
+static volatile int	playq_readahead_gen = 0;
+/**
+ * @brief Conditional variable used to notify the readahead thread of
+ *        playlist changes.
+ */
+static GCond		playq_readahead_wakeup;
+
+/**
+ * @brief Notify the readahead thread that the upcoming songs may have
+ *        changed, cancelling the readahead in progress. The playlist
+ *        should be locked.
+ */
+static void
+playq_readahead_kick(void)
+{
+	playq_readahead_gen++;
+	g_cond_signal(&playq_readahead_wakeup);
+}
+
+/**
+ * @brief Read at most len bytes of a file into the page cache. Returns
+ *        the amount of bytes read.
+ */
+static off_t
+playq_readahead_file(const char *filename, off_t len, int gen)
+{
+	struct stat st;
+	int fd;
+#ifndef POSIX_FADV_WILLNEED
+	char buf[65536];
+	off_t done;
+	ssize_t ret;
+#endif /* !POSIX_FADV_WILLNEED */
+
+	fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return (0);
+
+	/* Only regular files end up in the page cache */
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return (0);
+	}
+	len = MIN(len, st.st_size);
+
+#ifdef POSIX_FADV_WILLNEED
+	posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED);
+#else /* !POSIX_FADV_WILLNEED */
+	for (done = 0; done < len; done += ret) {
+		/* Stop reading when the playlist has been altered */
+		if (g_atomic_int_get(&playq_readahead_gen) != gen)
+			break;
+		ret = read(fd, buf, MIN((off_t)sizeof buf, len - done));
+		if (ret <= 0)
+			break;
+	}
+	len = done;
+#endif /* POSIX_FADV_WILLNEED */
+
+	close(fd);
+	return (len);
+}
+
+/**
+ * @brief Read the songs that are going to be played next into the page
+ *        cache, so opening them doesn't hit cold storage.
+ */
+static void *
+playq_readahead_thread(void *unused)
+{
+	struct vfsref *vr;
+	char **filenames;
+	unsigned int i, len;
+	off_t budget;
+	int gen = -1;
+
+	gui_input_sigmask();
+
+	filenames = g_new(char *, playq_readahead_count);
+
+	playq_lock();
+	for (;;) {
+		while (!playq_quit && gen == playq_readahead_gen)
+			g_cond_wait(&playq_readahead_wakeup, &playq_mtx);
+		if (playq_quit)
+			break;
+
+		/* Obtain the filenames of the upcoming songs */
+		gen = playq_readahead_gen;
+		for (len = 0; len < playq_readahead_count; len++) {
+			if ((vr = funcs->peek(len)) == NULL)
+				break;
+			filenames[len] = g_strdup(vfs_filename(vr));
+			vfs_close(vr);
+		}
+		playq_unlock();
+
+		budget = playq_readahead_size;
+		for (i = 0; i < len; i++) {
+			if (budget > 0 &&
+			    g_atomic_int_get(&playq_readahead_gen) == gen)
+				budget -= playq_readahead_file(filenames[i],
+				    budget, gen);
+			g_free(filenames[i]);
+		}
+
+		playq_lock();
+	}
+	playq_unlock();
+
+	g_free(filenames);
+	return (NULL);
+}
+
+/**
+ * @brief Open the songs requested by the decoder and decode their first
+ *        chunks, so playback can continue without a gap.
+ */
+static void *
+playq_primer_thread(void *unused)
+{
+	struct audio_file *fd;
+	struct audio_chunk *ac;
+	unsigned int len;
+
+	gui_input_sigmask();
+
+	playq_lock();
+	for (;;) {
+		while (!playq_quit && !playq_prime_busy)
+			g_cond_wait(&playq_prime_wakeup, &playq_mtx);
+		if (playq_quit) {
+			/* Don't let the decoder wait for us */
+			playq_prime_busy = 0;
+			g_cond_broadcast(&playq_prime_wakeup);
+			break;
+		}
+		playq_unlock();
+
+		/* The decoder leaves the song alone while we're busy */
+		fd = audio_file_open(playq_prime_vr);
+		for (len = 0; fd != NULL && !fd->stream &&
+		    len < PLAYQ_PRIME_CHUNKS; len++) {
+			ac = &playq_prime_buf[len];
+			ac->fd = NULL;
+			ac->frame = fd->frame_cur;
+			ac->len = audio_file_read(fd, ac->buf, AUDIO_CHUNK_LEN);
+			if (ac->len == 0)
+				break;
+			ac->srate = fd->srate;
+			ac->channels = fd->channels;
+		}
+
+		playq_lock();
+		playq_prime_fd = fd;
+		playq_prime_len = len;
+		playq_prime_busy = 0;
+		g_cond_broadcast(&playq_prime_wakeup);
+	}
+	playq_unlock();
+
+	return (NULL);
+}
+
+/**
+ * @brief Let the primer open the song that is going to be played after
+ *        the current one. The playlist should be locked.
+ */
+static void
+playq_prime_start(void)
+{
+	/* Don't overwrite chunks the decoder still needs */
+	if (playq_prime_vr != NULL || playq_primed_fd != NULL ||
+	    playq_flags & PF_STOP)
+		return;
+
+	playq_prime_vr = funcs->peek(0);
+	if (playq_prime_vr != NULL) {
+		playq_prime_busy = 1;
+		g_cond_signal(&playq_prime_wakeup);
+	}
+}
+
+/**
+ * @brief Take the primed song when it matches the song the decoder is
+ *        going to play, discarding it otherwise. The playlist should be
+ *        locked.
+ */
+static struct audio_file *
+playq_prime_take(const struct vfsref *vr)
+{
+	struct audio_file *fd = NULL;
+
+	while (playq_prime_busy)
+		g_cond_wait(&playq_prime_wakeup, &playq_mtx);
+	if (playq_prime_vr == NULL)
+		return (NULL);
+
+	if (vr != NULL &&
+	    strcmp(vfs_filename(vr), vfs_filename(playq_prime_vr)) == 0) {
+		fd = playq_prime_fd;
+		/* Streams aren't primed and reads may have failed */
+		if (fd != NULL && playq_prime_len > 0) {
+			playq_primed_fd = fd;
+			playq_prime_idx = 0;
+			playq_prime_off = 0;
+		}
+	} else if (playq_prime_fd != NULL) {
+		/* Playlist changed in the mean time */
+		audio_file_close(playq_prime_fd);
+	}
+
+	vfs_close(playq_prime_vr);
+	playq_prime_vr = NULL;
+	playq_prime_fd = NULL;
+	return (fd);
+}
+
+/**
+ * @brief Decode audio of a song, consuming the chunks decoded by the
+ *        primer first. The position of the first frame is stored in
+ *        frame.
+ */
+static size_t
+playq_decode(struct audio_file *fd, float *buf, size_t len,
+    int64_t *frame)
+{
+	struct audio_chunk *pc;
+	size_t ret;
+
+	if (fd == playq_primed_fd && playq_prime_idx >= playq_prime_len)
+		/* Never read beyond the primed chunks */
+		playq_primed_fd = NULL;
+	if (fd != playq_primed_fd) {
+		*frame = fd->frame_cur;
+		return (audio_file_read(fd, buf, len));
+	}
+
+	pc = &playq_prime_buf[playq_prime_idx];
+	ret = MIN(len, pc->len - playq_prime_off);
+	memcpy(buf, pc->buf + playq_prime_off, ret * sizeof(float));
+	*frame = pc->frame + playq_prime_off / pc->channels;
+
+	playq_prime_off += ret;
+	if (playq_prime_off == pc->len) {
+		/* Move on to the next chunk */
+		playq_prime_off = 0;
+		if (++playq_prime_idx >= playq_prime_len)
+			playq_primed_fd = NULL;
+	}
+	return (ret);
+}
 
 /**
- * @brief Infinitely play music in the playlist, honouring the
- *        playq_flags.
+ * @brief Close a song that was being decoded.
+ */
+static void
+playq_close(struct audio_file *fd)
+{
+	if (fd == playq_primed_fd)
+		playq_primed_fd = NULL;
+	audio_file_close(fd);
+}
+
+/**
+ * @brief Warn the user that a song could not be opened.
+ */
+static void
+playq_open_failed(const struct vfsref *vr)
+{
+	char *errmsg;
+
+	errmsg = g_strdup_printf(_("Failed to open \"%s\" for playback."),
+	    vfs_name(vr));
+	gui_msgbar_warn(errmsg);
+	g_free(errmsg);
+}
+
+/**
+ * @brief Tell the audio output thread that the decoder has moved on to
+ *        a new song.
+ */
+static void
+playq_announce(struct audio_file *fd)
+{
+	playq_lock();
+	playq_decoding = fd;
+	playq_readahead_kick();
+	playq_unlock();
+
+	playq_buffer_marker(fd);
+}
+
+/**
+ * @brief Open the next song in the playlist while the current song is
+ *        still being decoded, leaving it in the playlist.
+ */
+static struct audio_file *
+playq_xfade_open(void)
+{
+	struct vfsref *nvr;
+	struct audio_file *fd;
+
+	playq_lock();
+	if (playq_quit || playq_flags & (PF_SKIP|PF_STOP) ||
+	    (nvr = funcs->peek(0)) == NULL) {
+		playq_unlock();
+		return (NULL);
+	}
+	fd = playq_prime_take(nvr);
+	playq_unlock();
+
+	if (fd == NULL && (fd = audio_file_open(nvr)) == NULL) {
+		playq_open_failed(nvr);
+		vfs_close(nvr);
+		return (NULL);
+	}
+	playq_xfade_vr = nvr;
+
+	return (fd);
+}
+
+/**
+ * @brief Close the song that is faded in, when the decoder moves on to
+ *        a different song.
+ */
+static void
+playq_xfade_close(struct audio_file *xf)
+{
+	playq_close(xf);
+	vfs_close(playq_xfade_vr);
+	playq_xfade_vr = NULL;
+}
+
+/**
+ * @brief Take the song that is faded in from the playlist, now that it
+ *        becomes the current song. When nvr is NULL, the song is
+ *        fetched from the playlist as well. The song from the playlist
+ *        is opened instead when the playlist has changed in the mean
+ *        time, which the caller should announce. Returns NULL when
+ *        there's no song to continue with.
+ */
+static struct audio_file *
+playq_xfade_take(struct audio_file *xf, struct vfsref *nvr)
+{
+	struct audio_file *fd;
+
+	if (nvr == NULL) {
+		playq_lock();
+		nvr = funcs->give();
+		playq_unlock();
+		if (nvr == NULL) {
+			playq_xfade_close(xf);
+			return (NULL);
+		}
+	}
+
+	if (strcmp(vfs_filename(nvr), vfs_filename(playq_xfade_vr)) == 0) {
+		fd = xf;
+		vfs_close(playq_xfade_vr);
+		playq_xfade_vr = NULL;
+	} else {
+		if ((fd = audio_file_open(nvr)) == NULL)
+			playq_open_failed(nvr);
+		playq_xfade_close(xf);
+	}
+	vfs_close(nvr);
+
+	return (fd);
+}
+
+/**
+ * @brief Decode audio of the song that is faded in and mix it into a
+ *        chunk of the song that is faded out.
+ */
+static void
+playq_xfade_mix(struct audio_chunk *ac, struct audio_file *xf,
+    unsigned int pos, unsigned int len)
+{
+	size_t frames, done, ret;
+	int64_t frame;
+
+	frames = ac->len / ac->channels;
+	for (done = 0; done < frames * xf->channels; done += ret) {
+		ret = playq_decode(xf, playq_xfade_raw + done,
+		    frames * xf->channels - done, &frame);
+		/* Show the position of the song that is faded in */
+		if (done == 0)
+			ac->frame = frame;
+		if (ret == 0) {
+			/* Song is shorter than the fade */
+			memset(playq_xfade_raw + done, 0,
+			    (frames * xf->channels - done) * sizeof(float));
+			break;
+		}
+	}
+
+	audio_dsp_remap(playq_xfade_buf, ac->channels,
+	    playq_xfade_raw, xf->channels, frames);
+	audio_dsp_crossfade(ac->buf, playq_xfade_buf, ac->len,
+	    (unsigned long)pos * ac->channels,
+	    (unsigned long)len * ac->channels);
+}
+
+/**
+ * @brief Infinitely decode music in the playlist, honouring the
+ *        playq_flags, and place it in the audio buffer.
  */
 static void *
 playq_runner_thread(void *unused)
 {
 	struct vfsref		*nvr;
-	struct audio_file	*cur;
-	char			*errmsg;
+	struct audio_file	*cur, *xf = NULL, *next = NULL;
+	struct audio_chunk	*ac;
+	size_t			len;
+	int64_t			frame;
+	unsigned int		xfpos = 0, xflen = 0;
+	int			idle = 1, xfdone = 0;
 
 	gui_input_sigmask();
+	playq_sched_thread("playq", 0);
 
 	do {
 		/* Wait until there's a song available */
 		playq_lock();
 		for (;;) {
+			playq_cmd_poll();
+
 			/* Shut down when the user wants to */
-			if (playq_flags & PF_QUIT) {
+			if (playq_quit) {
 				playq_unlock();
 				goto done;
 			}
@@ -177,67 +833,364 @@ playq_runner_thread(void *unused)
 			if (!(playq_flags & PF_STOP) &&
 			    (nvr = funcs->give()) != NULL) {
 				/* We've got work to do */
+				cur = playq_prime_take(nvr);
 				break;
 			}
+			playq_prime_take(NULL);
+			if (next != NULL) {
+				/* Stopped, or nothing to play after skipping */
+				playq_unlock();
+				playq_xfade_close(next);
+				next = NULL;
+				playq_lock();
+			}
 
 			/* Wait for new events to occur */
 			playq_flags |= PF_STOP;
 			funcs->idle();
-			gui_playq_song_update(NULL, 0, 0);
+			if (!idle) {
+				/* Let the audio output go idle as well */
+				playq_unlock();
+				playq_buffer_marker(NULL);
+				idle = 1;
+				playq_lock();
+				continue;
+			}
 			g_cond_wait(&playq_wakeup, &playq_mtx);
 		}
 		playq_unlock();
 
-		cur = audio_file_open(nvr);
-		if (cur == NULL) {
+		if (next != NULL) {
+			/* Continue with the song that was being faded in */
+			if (cur != NULL)
+				playq_close(cur);
+			cur = playq_xfade_take(next, nvr);
+			next = NULL;
+			if (cur == NULL) {
+				g_usleep(500000);
+				continue;
+			}
+		} else if (cur == NULL &&
+		    (cur = audio_file_open(nvr)) == NULL) {
 			/* Skip broken songs */
-			errmsg = g_strdup_printf(
-			    _("Failed to open \"%s\" for playback."),
-			    vfs_name(nvr));
-			gui_msgbar_warn(errmsg);
-			g_free(errmsg);
+			playq_open_failed(nvr);
 			vfs_close(nvr);
 			/* Don't hog the CPU */
 			g_usleep(500000);
 			continue;
+		} else {
+			/* Trash it */
+			vfs_close(nvr);
 		}
 
-		/* Trash it */
-		vfs_close(nvr);
-		gui_playq_song_update(cur, 0, 0);
-
-		playq_lock();
-		playq_flags &= ~(PF_PAUSE|PF_SKIP|PF_SEEK);
-		playq_unlock();
+		playq_flags &= ~(PF_SKIP|PF_SEEK);
 
-		do  {
-			if (playq_flags & PF_PAUSE && !cur->stream) {
-				gui_playq_song_update(cur, 1, 1);
-
-				/* Wait to be waken up */
-				playq_lock();
-				g_cond_wait(&playq_wakeup, &playq_mtx);
-				playq_unlock();
-			} else {
-				gui_playq_song_update(cur, 0, 1);
+		idle = 0;
+		xfdone = 0;
+		playq_announce(cur);
 
-				/* Play a part of the audio file */
-				if (audio_output_play(cur) != 0)
-					break;
+		for (;;) {
+			ac = playq_buffer_get(PF_SKIP|PF_SEEK);
+			if (ac != NULL) {
+				/* Decode a part of the audio file */
+				len = AUDIO_CHUNK_LEN;
+				if (xflen != 0 && xf != NULL)
+					/* Leave room for the other song */
+					len = len / MAX(cur->channels,
+					    xf->channels) * cur->channels;
+				ac->fd = NULL;
+				ac->len = playq_decode(cur, ac->buf, len,
+				    &ac->frame);
+				if (ac->len == 0) {
+					if (xf == NULL)
+						break;
+
+					/* Continue with the next song */
+					playq_close(cur);
+					cur = playq_xfade_take(xf, NULL);
+					xfdone = 0;
+					if (cur == NULL) {
+						xf = NULL;
+						break;
+					}
+					if (xflen == 0 || cur != xf)
+						playq_announce(cur);
+					xf = NULL;
+					continue;
+				}
+				ac->srate = cur->srate;
+				ac->channels = cur->channels;
+
+				if (xf != NULL && xflen != 0) {
+					playq_xfade_mix(ac, xf, xfpos, xflen);
+					xfpos += ac->len / ac->channels;
+				} else if (xfpos < xflen) {
+					/* Previous song ended early - fade in */
+					memcpy(playq_xfade_buf, ac->buf,
+					    ac->len * sizeof(float));
+					memset(ac->buf, 0,
+					    ac->len * sizeof(float));
+					audio_dsp_crossfade(ac->buf,
+					    playq_xfade_buf, ac->len,
+					    (unsigned long)xfpos * ac->channels,
+					    (unsigned long)xflen * ac->channels);
+					xfpos += ac->len / ac->channels;
+				}
+				audio_buffer_write_end();
+
+				if (xfpos >= xflen) {
+					/* Fade has been completed */
+					if (xf != NULL && xflen != 0) {
+						playq_close(cur);
+						cur = playq_xfade_take(xf, NULL);
+						xfdone = 0;
+						if (cur == NULL) {
+							xf = NULL;
+							break;
+						}
+						if (cur != xf)
+							playq_announce(cur);
+						xf = NULL;
+					}
+					xfpos = xflen = 0;
+				}
+
+				/* Open the next song when we're almost done */
+				if (xf == NULL && !xfdone && !cur->stream &&
+				    cur->time_len != 0 &&
+				    cur->time_cur + PLAYQ_PRIME_TIME +
+				    playq_xfade >= cur->time_len) {
+					playq_lock();
+					playq_prime_start();
+					playq_unlock();
+
+					if (playq_xfade != 0 &&
+					    cur->time_cur + playq_xfade >=
+					    cur->time_len) {
+						xfdone = 1;
+						xf = playq_xfade_open();
+					}
+					if (xf != NULL && xf->srate == cur->srate &&
+					    !xf->stream) {
+						/* Start overlapping the songs */
+						xfpos = 0;
+						xflen = playq_xfade * cur->srate;
+						playq_announce(xf);
+					}
+				}
 			}
 
 			if (playq_flags & PF_SEEK) {
-				audio_file_seek(cur, playq_seek_time,
-				    playq_flags & PF_SEEK_REL);
-				playq_lock();
+				if (xf != NULL && xflen != 0) {
+					/* Seeking the song that is faded in */
+					playq_close(cur);
+					cur = playq_xfade_take(xf, NULL);
+					xfdone = 0;
+					if (cur == NULL) {
+						xf = NULL;
+						break;
+					}
+					if (cur != xf)
+						playq_announce(cur);
+					xf = NULL;
+				}
+				xfpos = xflen = 0;
+
+				/* Relative to the audio that is being played */
+				frame = (int64_t)playq_seek_time * cur->srate;
+				if (playq_flags & PF_SEEK_REL) {
+					g_mutex_lock(&playq_pos_mtx);
+					frame += cur->frame_play;
+					g_mutex_unlock(&playq_pos_mtx);
+				}
+				audio_file_seek(cur, frame);
 				playq_flags &= ~PF_SEEK;
-				playq_unlock();
+				if (cur == playq_primed_fd)
+					playq_primed_fd = NULL;
+				/* Throw away audio decoded before the seek */
+				if (!cur->stream)
+					audio_buffer_flush();
 			}
-		} while (!(playq_flags & (PF_QUIT|PF_SKIP)));
 
-		audio_file_close(cur);
-	} while (!(playq_flags & PF_QUIT));
+			if (playq_quit || playq_flags & PF_SKIP) {
+				audio_buffer_flush();
+				break;
+			}
+		}
+
+		playq_lock();
+		playq_decoding = NULL;
+		playq_unlock();
+		if (cur != NULL)
+			playq_close(cur);
+		if (xf != NULL) {
+			if (xflen != 0 && !playq_quit &&
+			    !(playq_flags & PF_STOP)) {
+				/*
+				 * The song that is faded in can already be
+				 * heard, so skipping only skips the song that
+				 * is faded out.
+				 */
+				next = xf;
+			} else {
+				playq_xfade_close(xf);
+			}
+			xf = NULL;
+		}
+		xfpos = xflen = 0;
+	} while (!playq_quit);
 done:
+	if (next != NULL)
+		playq_xfade_close(next);
+	return (NULL);
+}
+
+/**
+ * @brief Write a chunk to the audio output device, converting it to the
+ *        fixed sample rate and amount of channels when configured.
+ */
+static int
+playq_output_play(const struct audio_chunk *ac)
+{
+	struct audio_chunk *oc = &playq_out_chunk;
+	size_t frames, done, len, used, ret;
+	const float *in;
+
+	oc->srate = playq_out_srate != 0 ? playq_out_srate : ac->srate;
+	oc->channels = playq_out_channels != 0 ?
+	    playq_out_channels : ac->channels;
+	if (oc->srate == ac->srate && oc->channels == ac->channels)
+		return (audio_output_play(ac));
+
+	audio_resample_setup(oc->channels, ac->srate, oc->srate);
+	/* Let the audio output notice flushes */
+	oc->gen = ac->gen;
+	oc->frame = ac->frame;
+
+	frames = ac->len / ac->channels;
+	for (done = 0; done < frames; done += len) {
+		len = MIN(frames - done, AUDIO_CHUNK_LEN / oc->channels);
+		audio_dsp_remap(playq_out_raw, oc->channels,
+		    ac->buf + done * ac->channels, ac->channels, len);
+
+		for (in = playq_out_raw, used = len; used > 0; ) {
+			ret = used;
+			oc->len = audio_resample_run(oc->buf,
+			    AUDIO_CHUNK_LEN / oc->channels, in, &ret) *
+			    oc->channels;
+			in += ret * oc->channels;
+			used -= ret;
+
+			if (audio_buffer_stale(ac))
+				return (0);
+			if (oc->len != 0 && audio_output_play(oc) != 0)
+				return (-1);
+		}
+	}
+
+	return (0);
+}
+
+/**
+ * @brief Store the position of the audio that is audible. It lags
+ *        behind the chunk that has just been written by the delay of
+ *        the audio output device.
+ */
+static void
+playq_output_position(struct audio_file *fd, const struct audio_chunk *ac)
+{
+	unsigned int srate;
+	int64_t frame;
+
+	/* The delay is measured at the sample rate of the device */
+	srate = playq_out_srate != 0 ? playq_out_srate : ac->srate;
+	frame = ac->frame + ac->len / ac->channels -
+	    (int64_t)audio_output_delay() * ac->srate / srate;
+
+	/* A 64 bits store isn't atomic on every architecture */
+	frame = MAX(frame, 0);
+	g_mutex_lock(&playq_pos_mtx);
+	fd->frame_play = frame;
+	g_mutex_unlock(&playq_pos_mtx);
+	fd->time_play = frame / ac->srate;
+}
+
+/**
+ * @brief Write the decoded audio in the audio buffer to the audio
+ *        output device.
+ */
+static void *
+playq_output_thread(void *unused)
+{
+	struct audio_file *out = NULL;
+	struct audio_chunk *ac;
+	unsigned int ev, gen, out_gen;
+	int paused, was_paused = 0, skip = 0;
+
+	gui_input_sigmask();
+	playq_sched_thread("output", 1);
+	out_gen = audio_buffer_generation();
+
+	for (;;) {
+		ev = audio_buffer_events();
+		if (playq_quit)
+			break;
+
+		ac = audio_buffer_read_begin();
+
+		/* Silence the audio device when the buffer has been flushed */
+		gen = (ac != NULL && ac->len != 0) ?
+		    ac->gen : audio_buffer_generation();
+		if (gen != out_gen) {
+			out_gen = gen;
+			audio_output_flush();
+			audio_resample_reset();
+		}
+
+		if (ac != NULL && ac->len == 0) {
+			/* Marker - a new song starts or playback stops */
+			if (out != NULL)
+				audio_file_unref(out);
+			out = ac->fd;
+			audio_buffer_read_end();
+
+			skip = 0;
+			audio_buffer_fill_reset();
+			gui_playq_song_update(out, 0, 0);
+			continue;
+		}
+
+		/* Streams cannot be paused */
+		paused = g_atomic_int_get(&playq_paused) && out != NULL &&
+		    !out->stream;
+		if (paused != was_paused) {
+			audio_output_pause(paused);
+			if (paused)
+				gui_playq_song_update(out, 1, 1);
+		}
+		was_paused = paused;
+		if (paused || ac == NULL) {
+			/* Nothing to do */
+			audio_buffer_wait(ev);
+			continue;
+		}
+
+		audio_volume_apply(ac->buf, ac->len);
+		if (!skip && playq_output_play(ac) != 0) {
+			/* Skip the remainder of the song */
+			skip = 1;
+			if (playq_cmd_push(PLAYQ_CMD_SKIP_FILE, 0, out) == 0)
+				audio_buffer_wakeup();
+		}
+
+		if (!audio_buffer_stale(ac))
+			playq_output_position(out, ac);
+		audio_buffer_read_end();
+		gui_playq_song_update(out, 0, 1);
+	}
+
+	if (out != NULL)
+		audio_file_unref(out);
 	return (NULL);
 }
 
@@ -248,8 +1201,24 @@ playq_init(int autoplay, int xmms, int load_dumpfile)
 	struct vfsref *vr;
 
 	g_mutex_init(&playq_mtx);
+	g_mutex_init(&playq_pos_mtx);
 	g_cond_init(&playq_wakeup);
+	g_cond_init(&playq_prime_wakeup);
+	g_cond_init(&playq_readahead_wakeup);
+	playq_cmd_init();
 	playq_rand = g_rand_new(); /* XXX: /dev/urandom in chroot() */
+	audio_dsp_init();
+	audio_resample_init();
+	audio_volume_init();
+	audio_buffer_init();
+	playq_sched_init();
+
+	playq_xfade = config_getopt_number("playq.crossfade");
+	playq_out_srate = config_getopt_number("audio.output.rate");
+	playq_out_channels = config_getopt_number("audio.output.channels");
+	playq_readahead_count = config_getopt_number("playq.readahead.count");
+	playq_readahead_size =
+	    (off_t)config_getopt_number("playq.readahead.size") * 1024;
 
 	if (autoplay || config_getopt_bool("playq.autoplay"))
 		playq_flags &= ~PF_STOP;
@@ -274,6 +1243,11 @@ void
 playq_spawn(void)
 {
 	playq_runner = g_thread_new("playq", playq_runner_thread, NULL);
+	playq_output = g_thread_new("output", playq_output_thread, NULL);
+	playq_primer = g_thread_new("primer", playq_primer_thread, NULL);
+	if (playq_readahead_count > 0)
+		playq_readahead = g_thread_new("readahead",
+		    playq_readahead_thread, NULL);
 }
 
 void
@@ -283,10 +1257,18 @@ playq_shutdown(void)
 	const char *filename;
 
 	playq_lock();
-	playq_flags = PF_QUIT;
+	playq_quit = 1;
 	playq_unlock();
 	g_cond_signal(&playq_wakeup);
+	g_cond_broadcast(&playq_prime_wakeup);
+	g_cond_signal(&playq_readahead_wakeup);
+	audio_buffer_wakeup();
 	g_thread_join(playq_runner);
+	g_thread_join(playq_output);
+	g_thread_join(playq_primer);
+	if (playq_readahead != NULL)
+		g_thread_join(playq_readahead);
+	playq_prime_take(NULL);
 
 	filename = config_getopt("playq.dumpfile");
 	if (filename[0] != '\0') {
@@ -326,6 +1308,7 @@ playq_song_add_head(struct vfsref *vr)
 
 	gui_playq_notify_done();
 	g_cond_signal(&playq_wakeup);
+	playq_readahead_kick();
 	playq_unlock();
 }
 
@@ -349,6 +1332,7 @@ playq_song_add_tail(struct vfsref *vr)
 
 	gui_playq_notify_done();
 	g_cond_signal(&playq_wakeup);
+	playq_readahead_kick();
 	playq_unlock();
 }
 
@@ -358,15 +1342,7 @@ playq_song_add_tail(struct vfsref *vr)
 void
 playq_cursong_seek(int len, int rel)
 {
-	int fl;
-
-	fl = rel ? PF_SEEK_REL : PF_SEEK_ABS;
-	playq_lock();
-	playq_flags = (playq_flags & ~PF_SEEK) | fl;
-	playq_seek_time = len;
-	playq_unlock();
-
-	g_cond_signal(&playq_wakeup);
+	playq_cmd_send(rel ? PLAYQ_CMD_SEEK_REL : PLAYQ_CMD_SEEK_ABS, len);
 }
 
 void
@@ -375,8 +1351,10 @@ playq_cursong_next(void)
 	playq_lock();
 	if (funcs->next() == 0) {
 		/* Unpause as well */
-		playq_flags |= PF_SKIP;
+		playq_cmd_send(PLAYQ_CMD_SKIP, 0);
 		g_cond_signal(&playq_wakeup);
+		playq_readahead_kick();
+		audio_buffer_flush();
 	}
 	playq_unlock();
 }
@@ -387,8 +1365,10 @@ playq_cursong_prev(void)
 	playq_lock();
 	if (funcs->prev() == 0) {
 		/* Unpause as well */
-		playq_flags |= PF_SKIP;
+		playq_cmd_send(PLAYQ_CMD_SKIP, 0);
 		g_cond_signal(&playq_wakeup);
+		playq_readahead_kick();
+		audio_buffer_flush();
 	}
 	playq_unlock();
 }
@@ -396,23 +1376,23 @@ playq_cursong_prev(void)
 void
 playq_cursong_stop(void)
 {
-	playq_lock();
-	/* Stop playback */
-	playq_flags |= (PF_SKIP|PF_STOP);
-	playq_unlock();
-
-	g_cond_signal(&playq_wakeup);
+	playq_cmd_send(PLAYQ_CMD_STOP, 0);
+	audio_buffer_flush();
 }
 
 void
 playq_cursong_pause(void)
 {
-	playq_lock();
-	/* Toggle the pause flag */
-	playq_flags ^= PF_PAUSE;
-	playq_unlock();
+	int paused;
 
-	g_cond_signal(&playq_wakeup);
+	/* Toggle the flag, even when pausing from multiple threads */
+	do {
+		paused = g_atomic_int_get(&playq_paused);
+	} while (!g_atomic_int_compare_and_exchange(&playq_paused,
+	    paused, !paused));
+
+	/* Let the audio output know right away */
+	audio_buffer_wakeup();
 }
 
 void
@@ -436,6 +1416,7 @@ playq_song_fast_remove(struct vfsref *vr, unsigned int index)
 	vfs_list_remove(&playq_list, vr);
 	vfs_close(vr);
 	gui_playq_notify_done();
+	playq_readahead_kick();
 }
 
 void
@@ -458,6 +1439,7 @@ playq_song_fast_add_before(struct vfsref *nvr, struct vfsref *lvr,
 
 	gui_playq_notify_done();
 	g_cond_signal(&playq_wakeup);
+	playq_readahead_kick();
 }
 
 void
@@ -480,6 +1462,7 @@ playq_song_fast_add_after(struct vfsref *nvr, struct vfsref *lvr,
 
 	gui_playq_notify_done();
 	g_cond_signal(&playq_wakeup);
+	playq_readahead_kick();
 }
 
 void
@@ -496,6 +1479,7 @@ playq_song_fast_move_up(struct vfsref *vr, unsigned int index)
 	vfs_list_insert_after(&playq_list, pvr, vr);
 	gui_playq_notify_post_insertion(index);
 	gui_playq_notify_done();
+	playq_readahead_kick();
 }
 
 void
@@ -512,7 +1496,7 @@ playq_song_fast_move_down(struct vfsref *vr, unsigned int index)
 	vfs_list_insert_before(&playq_list, nvr, vr);
 	gui_playq_notify_post_insertion(index);
 	gui_playq_notify_done();
-
+	playq_readahead_kick();
 }
 
 void
@@ -526,6 +1510,7 @@ playq_song_fast_move_head(struct vfsref *vr, unsigned int index)
 	vfs_list_insert_head(&playq_list, vr);
 	gui_playq_notify_post_insertion(1);
 	gui_playq_notify_done();
+	playq_readahead_kick();
 }
 
 void
@@ -539,6 +1524,7 @@ playq_song_fast_move_tail(struct vfsref *vr, unsigned int index)
 	vfs_list_insert_tail(&playq_list, vr);
 	gui_playq_notify_post_insertion(vfs_list_items(&playq_list));
 	gui_playq_notify_done();
+	playq_readahead_kick();
 }
 
 void
@@ -548,9 +1534,10 @@ playq_song_fast_select(struct vfsref *vr)
 		return;
 
 	/* Now go to the next song */
-	playq_flags &= ~PF_STOP;
-	playq_flags |= PF_SKIP;
+	playq_cmd_send(PLAYQ_CMD_START, 0);
 	g_cond_signal(&playq_wakeup);
+	playq_readahead_kick();
+	audio_buffer_flush();
 }
 
 void
@@ -566,6 +1553,7 @@ playq_song_remove_all(void)
 		vfs_close(vr);
 	}
 	gui_playq_notify_done();
+	playq_readahead_kick();
 	playq_unlock();
 }
 
@@ -607,5 +1595,6 @@ playq_song_randomize(void)
 
 	gui_playq_notify_post_randomization();
 	gui_playq_notify_done();
+	playq_readahead_kick();
 done:	playq_unlock();
 }
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file playq_cmd.c
+ * @brief Queue of playback control commands.
+ */
+
+#include "stdinc.h"
+
+#include "playq_cmd.h"
+
+/*
+ * The queue is a bounded array of cells, each containing a sequence
+ * number. A producer claims a cell by atomically incrementing the
+ * enqueue position when the sequence number of the cell matches it.
+ * After storing the command, it sets the sequence number to the next
+ * position, which marks the cell as filled for the consumer. The
+ * consumer releases the cell by advancing its sequence number by the
+ * size of the queue.
+ */
+
+/**
+ * @brief Amount of commands that fit in the queue. Must be a power of
+ *        two.
+ */
+#define PLAYQ_CMD_LEN	64
+
+/**
+ * @brief A slot in the command queue.
+ */
+struct playq_cmd_cell {
+	/**
+	 * @brief Sequence number of the cell. It should only be used
+	 *        with g_atomic_* operations.
+	 */
+	volatile int		seq;
+	/**
+	 * @brief The command stored in the cell.
+	 */
+	struct playq_cmd	cmd;
+};
+
+/**
+ * @brief The cells of the command queue.
+ */
+static struct playq_cmd_cell	playq_cmd_cells[PLAYQ_CMD_LEN];
+/**
+ * @brief Position at which the next command will be stored.
+ */
+static volatile int		playq_cmd_head = 0;
+/**
+ * @brief Position of the next command that will be removed. Only used
+ *        by the consumer.
+ */
+static unsigned int		playq_cmd_tail = 0;
+
+void
+playq_cmd_init(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < PLAYQ_CMD_LEN; i++)
+		g_atomic_int_set(&playq_cmd_cells[i].seq, i);
+}
+
+int
+playq_cmd_push(int type, int seek, struct audio_file *fd)
+{
+	struct playq_cmd_cell *cell;
+	unsigned int pos;
+	int dif;
+
+	for (;;) {
+		pos = g_atomic_int_get(&playq_cmd_head);
+		cell = &playq_cmd_cells[pos % PLAYQ_CMD_LEN];
+		dif = g_atomic_int_get(&cell->seq) - (int)pos;
+
+		if (dif < 0) {
+			/* Consumer hasn't released the cell yet */
+			return (-1);
+		} else if (dif == 0 &&
+		    g_atomic_int_compare_and_exchange(&playq_cmd_head,
+		    pos, pos + 1)) {
+			/* We've claimed the cell */
+			break;
+		}
+		/* Another producer was faster */
+	}
+
+	cell->cmd.type = type;
+	cell->cmd.seek = seek;
+	cell->cmd.fd = fd;
+	g_atomic_int_set(&cell->seq, pos + 1);
+	return (0);
+}
+
+int
+playq_cmd_pop(struct playq_cmd *cmd)
+{
+	struct playq_cmd_cell *cell;
+
+	cell = &playq_cmd_cells[playq_cmd_tail % PLAYQ_CMD_LEN];
+	if (g_atomic_int_get(&cell->seq) != (int)(playq_cmd_tail + 1))
+		return (-1);
+
+	*cmd = cell->cmd;
+	g_atomic_int_set(&cell->seq, playq_cmd_tail + PLAYQ_CMD_LEN);
+	playq_cmd_tail++;
+	return (0);
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file playq_cmd.h
+ * @brief Queue of playback control commands.
+ */
+
+struct audio_file;
+
+/**
+ * @brief Seek to an absolute position in seconds.
+ */
+#define PLAYQ_CMD_SEEK_ABS	2
+/**
+ * @brief Seek a relative amount of seconds.
+ */
+#define PLAYQ_CMD_SEEK_REL	3
+/**
+ * @brief Skip to the next song, unpausing playback.
+ */
+#define PLAYQ_CMD_SKIP		4
+/**
+ * @brief Skip the song stored in the command, when it's still being
+ *        decoded.
+ */
+#define PLAYQ_CMD_SKIP_FILE	5
+/**
+ * @brief Stop playback.
+ */
+#define PLAYQ_CMD_STOP		6
+/**
+ * @brief Skip to the next song, starting playback when stopped.
+ */
+#define PLAYQ_CMD_START		7
+
+/**
+ * @brief A command sent to the playback thread.
+ */
+struct playq_cmd {
+	/**
+	 * @brief Type of the command (PLAYQ_CMD_*).
+	 */
+	int			type;
+	/**
+	 * @brief Amount of seconds to seek.
+	 */
+	int			seek;
+	/**
+	 * @brief Song that should be skipped.
+	 */
+	struct audio_file	*fd;
+};
+
+/**
+ * @brief Initialize the command queue.
+ */
+void playq_cmd_init(void);
+/**
+ * @brief Append a command to the queue. This function may be called by
+ *        any thread without locking. It returns -1 when the queue is
+ *        full.
+ */
+int playq_cmd_push(int type, int seek, struct audio_file *fd);
+/**
+ * @brief Remove the oldest command from the queue. Only the playback
+ *        thread may call this function. It returns -1 when the queue
+ *        is empty.
+ */
+int playq_cmd_pop(struct playq_cmd *cmd);
@@ -40,6 +40,12 @@ extern int playq_repeat;
  *        (always the first song).
  */
 struct vfsref *playq_party_give(void);
+/**
+ * @brief Herrie's routine to look at the songs that will be returned
+ *        by the next calls to playq_party_give(), without removing
+ *        them. An index of zero returns the next song.
+ */
+struct vfsref *playq_party_peek(unsigned int idx);
 /**
  * @brief Herrie's idle indication function.
  */
@@ -67,6 +73,12 @@ void playq_party_notify_pre_removal(struct vfsref *vr);
  *        playlist.
  */
 struct vfsref *playq_xmms_give(void);
+/**
+ * @brief XMMS-like function that returns the songs that will be played
+ *        after the current song, without marking them. An index of
+ *        zero returns the next song.
+ */
+struct vfsref *playq_xmms_peek(unsigned int idx);
 /**
  * @brief XMMS-like function to notify that playback is going idle.
  */
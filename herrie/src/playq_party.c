@@ -61,6 +61,19 @@ playq_party_give(void)
 	return (nvr);
 }
 
+struct vfsref *
+playq_party_peek(unsigned int idx)
+{
+	struct vfsref *vr;
+
+	for (vr = vfs_list_first(&playq_list); vr != NULL && idx > 0; idx--)
+		vr = vfs_list_next(vr);
+	if (vr == NULL)
+		return (NULL);
+
+	return (vfs_dup(vr));
+}
+
 void
 playq_party_idle(void)
 {
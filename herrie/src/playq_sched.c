@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file playq_sched.c
+ * @brief Scheduling and memory locking of the playback threads.
+ */
+
+#include "stdinc.h"
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sched.h>
+
+#include "audio_buffer.h"
+#include "config.h"
+#include "gui.h"
+#include "playq_sched.h"
+
+/**
+ * @brief The amount of playback threads that call playq_sched_thread().
+ */
+#define PLAYQ_SCHED_THREADS	2
+
+/**
+ * @brief Scheduling policy, as named in the configuration file.
+ */
+struct playq_sched_policy {
+	/**
+	 * @brief Name of the policy in the configuration file.
+	 */
+	const char	*name;
+	/**
+	 * @brief The scheduling policy.
+	 */
+	int		policy;
+};
+
+/**
+ * @brief List of available scheduling policies.
+ */
+static struct playq_sched_policy policies[] = {
+	{ "other",	SCHED_OTHER },
+	{ "fifo",	SCHED_FIFO },
+	{ "rr",		SCHED_RR },
+};
+/**
+ * @brief The scheduling policy of the playback threads.
+ */
+static struct playq_sched_policy *policy = &policies[0];
+/**
+ * @brief Real-time priority of the audio output thread.
+ */
+static int		priority;
+/**
+ * @brief Niceness of the playback threads when no real-time policy is
+ *        used.
+ */
+static int		niceness;
+/**
+ * @brief List of processors the playback threads should run on.
+ */
+static const char	*cpus;
+/**
+ * @brief Settings that have actually been applied, shown in the
+ *        message bar when all threads have reported.
+ */
+static GString		*report = NULL;
+/**
+ * @brief Amount of playback threads that still have to report.
+ */
+static int		pending = 0;
+/**
+ * @brief Lock protecting the report.
+ */
+static GMutex		report_mtx;
+
+#ifdef __linux__
+/**
+ * @brief Convert a list of processors like "0,2-3" to a processor set.
+ */
+static int
+playq_sched_cpuset(const char *list, cpu_set_t *set)
+{
+	unsigned long first, last;
+	char *end;
+
+	CPU_ZERO(set);
+	while (*list != '\0') {
+		first = last = strtoul(list, &end, 10);
+		if (end == list)
+			return (-1);
+		if (*end == '-') {
+			list = end + 1;
+			last = strtoul(list, &end, 10);
+			if (end == list)
+				return (-1);
+		}
+
+		for (; first <= last && first < CPU_SETSIZE; first++)
+			CPU_SET(first, set);
+
+		if (*end == ',')
+			end++;
+		else if (*end != '\0')
+			return (-1);
+		list = end;
+	}
+
+	return (CPU_COUNT(set) > 0 ? 0 : -1);
+}
+#endif /* __linux__ */
+
+/**
+ * @brief Lock the memory of the application, including the stacks of
+ *        the playback threads and the decoder state that are allocated
+ *        later on, or at least the audio buffer.
+ */
+static void
+playq_sched_mlock(void)
+{
+	struct rlimit rl;
+
+	/*
+	 * Locking future allocations with a finite limit makes them fail
+	 * once the limit is reached, which GLib doesn't survive.
+	 */
+	if (getrlimit(RLIMIT_MEMLOCK, &rl) != 0)
+		rl.rlim_cur = 0;
+	if (rl.rlim_cur == RLIM_INFINITY &&
+	    mlockall(MCL_CURRENT|MCL_FUTURE) == 0) {
+		g_string_append(report, _(" all memory locked,"));
+		return;
+	}
+
+	if (rl.rlim_cur != RLIM_INFINITY)
+		g_string_append_printf(report, _(" memory lock limit %lu KiB,"),
+		    (unsigned long)(rl.rlim_cur / 1024));
+	if (audio_buffer_mlock() == 0)
+		g_string_append(report, _(" audio buffer locked,"));
+	else
+		g_string_append(report, _(" memory not locked,"));
+}
+
+void
+playq_sched_init(void)
+{
+	const char *name;
+	unsigned int i;
+	int memlock;
+
+	name = config_getopt("playq.sched.policy");
+	for (i = 0; i < G_N_ELEMENTS(policies); i++)
+		if (strcmp(policies[i].name, name) == 0)
+			policy = &policies[i];
+	priority = config_getopt_number("playq.sched.priority");
+	niceness = strtol(config_getopt("playq.sched.nice"), NULL, 10);
+	cpus = config_getopt("playq.sched.cpus");
+	memlock = config_getopt_bool("playq.sched.mlock");
+
+	/* Nothing to do - don't bother the user */
+	if (policy->policy == SCHED_OTHER && niceness == 0 &&
+	    cpus[0] == '\0' && !memlock)
+		return;
+
+	g_mutex_init(&report_mtx);
+	report = g_string_new(_("Scheduling:"));
+	pending = PLAYQ_SCHED_THREADS;
+
+	if (memlock)
+		playq_sched_mlock();
+}
+
+void
+playq_sched_thread(const char *name, int output)
+{
+	struct sched_param param;
+	GString *res;
+	int prio;
+#ifdef __linux__
+	cpu_set_t set;
+#endif /* __linux__ */
+
+	if (report == NULL)
+		return;
+
+	res = g_string_new(NULL);
+	g_string_printf(res, " %s", name);
+
+	if (policy->policy != SCHED_OTHER) {
+		/* The decoder has to yield to the output */
+		prio = output ? priority : priority - 1;
+		param.sched_priority = CLAMP(prio,
+		    sched_get_priority_min(policy->policy),
+		    sched_get_priority_max(policy->policy));
+		if (pthread_setschedparam(pthread_self(), policy->policy,
+		    &param) == 0)
+			g_string_append_printf(res, " %s %d",
+			    policy->name, param.sched_priority);
+		else
+			g_string_append(res, _(" no real-time priority"));
+	} else if (niceness != 0) {
+		/* Linux applies the niceness to the calling thread only */
+		if (setpriority(PRIO_PROCESS, 0, niceness) == 0)
+			g_string_append_printf(res, " nice %d", niceness);
+		else
+			g_string_append(res, _(" normal niceness"));
+	}
+
+	if (cpus[0] != '\0') {
+#ifdef __linux__
+		if (playq_sched_cpuset(cpus, &set) == 0 &&
+		    pthread_setaffinity_np(pthread_self(), sizeof set,
+		    &set) == 0)
+			g_string_append_printf(res, " cpus %s", cpus);
+		else
+#endif /* __linux__ */
+			g_string_append(res, _(" not pinned"));
+	}
+
+	g_mutex_lock(&report_mtx);
+	g_string_append(report, res->str);
+	if (--pending == 0) {
+		/* All threads are done - show the result */
+		gui_msgbar_warn(report->str);
+		g_string_free(report, TRUE);
+		report = NULL;
+	} else {
+		g_string_append_c(report, ',');
+	}
+	g_mutex_unlock(&report_mtx);
+
+	g_string_free(res, TRUE);
+}
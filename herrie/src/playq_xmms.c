@@ -78,6 +78,33 @@ playq_xmms_give(void)
 	return (vr);
 }
 
+struct vfsref *
+playq_xmms_peek(unsigned int idx)
+{
+	struct vfsref *vr;
+
+	if (selectsong != NULL) {
+		vr = selectsong;
+	} else if (cursong != NULL) {
+		vr = vfs_list_next(cursong);
+		if (vr == NULL && playq_repeat)
+			vr = vfs_list_first(&playq_list);
+	} else {
+		vr = vfs_list_first(&playq_list);
+	}
+
+	for (; vr != NULL && idx > 0; idx--) {
+		vr = vfs_list_next(vr);
+		if (vr == NULL && playq_repeat)
+			vr = vfs_list_first(&playq_list);
+	}
+
+	if (vr == NULL)
+		return (NULL);
+
+	return (vfs_dup(vr));
+}
+
 void
 playq_xmms_idle(void)
 {
@@ -165,9 +165,9 @@ scrobbler_notify_read(struct audio_file *fd, int eof)
 		/* Just take the position - catches formats without seeking */
 		len = fd->time_cur;
 	} else {
-		/* We may only submit if we're past four minutes or past 50% */
-		if ((fd->time_cur < 240) &&
-		    (fd->time_cur < (fd->time_len / 2)))
+		/* We may only submit if we've heard four minutes or 50% */
+		if ((fd->time_play < 240) &&
+		    (fd->time_play < (fd->time_len / 2)))
 			return;
 
 		len = fd->time_len;
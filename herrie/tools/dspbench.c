@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file dspbench.c
+ * @brief Microbenchmark comparing the conversion of libmad output with
+ *        the routines in audio_dsp against the per-sample loop that
+ *        mp3_read() used before.
+ *
+ * Build and run it from the source directory:
+ *
+ * cc -O2 -Isrc `pkg-config --cflags glib-2.0` tools/dspbench.c \
+ *     src/audio_dsp.c `pkg-config --libs glib-2.0` -o dspbench
+ * ./dspbench
+ */
+
+#include "stdinc.h"
+
+#include "audio_dsp.h"
+
+/**
+ * @brief Amount of samples per channel in a decoded MPEG frame.
+ */
+#define BENCH_FRAME	1152
+/**
+ * @brief Amount of frames converted per run, roughly an hour of audio
+ *        at 44.1 kHz.
+ */
+#define BENCH_FRAMES	140000
+/**
+ * @brief Fractional bits of libmad's fixed point format.
+ */
+#define BENCH_FRACBITS	28
+
+/**
+ * @brief Decoded samples of a single frame, as libmad stores them.
+ */
+static int32_t		bench_pcm[2][BENCH_FRAME];
+/**
+ * @brief Converted output of a single frame.
+ */
+static float		bench_out[2 * BENCH_FRAME];
+
+/**
+ * @brief The conversion loop of mp3_read() before it used audio_dsp.
+ */
+static void
+bench_loop(unsigned int channels)
+{
+	unsigned int i, c;
+	size_t written = 0;
+
+	for (i = 0; i < BENCH_FRAME && written < 2 * BENCH_FRAME; i++)
+		for (c = 0; c < channels; c++)
+			bench_out[written++] = (float)bench_pcm[c][i] *
+			    (1.0f / (1L << BENCH_FRACBITS));
+}
+
+/**
+ * @brief Conversion through audio_dsp_from_fixed().
+ */
+static void
+bench_dsp(unsigned int channels)
+{
+	audio_dsp_from_fixed(bench_out, bench_pcm[0],
+	    channels == 2 ? bench_pcm[1] : NULL, BENCH_FRAME, BENCH_FRACBITS);
+}
+
+/**
+ * @brief Print the time it takes to convert BENCH_FRAMES frames.
+ */
+static void
+bench_run(const char *name, void (*func)(unsigned int),
+    unsigned int channels)
+{
+	gint64 start;
+	double secs;
+	int i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < BENCH_FRAMES; i++) {
+		func(channels);
+		/* Prevent the compiler from merging the runs */
+		__asm__ __volatile__("" : : "r" (bench_out) : "memory");
+	}
+	secs = (g_get_monotonic_time() - start) / 1000000.0;
+	printf("%-8s %-7s %7.3f s %8.1f Msamples/s\n", name,
+	    channels == 2 ? "stereo" : "mono", secs,
+	    (double)BENCH_FRAMES * BENCH_FRAME * channels / secs / 1000000.0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned int c;
+	int i;
+
+	for (c = 0; c < 2; c++)
+		for (i = 0; i < BENCH_FRAME; i++)
+			bench_pcm[c][i] = (int32_t)g_random_int_range(
+			    -(1 << BENCH_FRACBITS), 1 << BENCH_FRACBITS);
+
+	for (c = 1; c <= 2; c++)
+		bench_run("loop", bench_loop, c);
+	/* The plain C kernels are used until initialisation */
+	for (c = 1; c <= 2; c++)
+		bench_run("dsp-c", bench_dsp, c);
+	audio_dsp_init();
+	for (c = 1; c <= 2; c++)
+		bench_run("dsp-simd", bench_dsp, c);
+
+	return (0);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file flushbench.c
+ * @brief Benchmark measuring how long it takes the audio output to go
+ *        silent after the audio buffer has been flushed, which is what
+ *        happens when skip or stop is pressed.
+ *
+ * It runs the real audio buffer and the null audio output with a
+ * decoder thread generating silence. Build and run it from the source
+ * directory:
+ *
+ * cc -O2 -Isrc `pkg-config --cflags glib-2.0` tools/flushbench.c \
+ *     src/audio_buffer.c src/audio_output_null.c \
+ *     `pkg-config --libs glib-2.0` -o flushbench
+ * ./flushbench
+ */
+
+#include "stdinc.h"
+
+#include "audio_buffer.h"
+#include "audio_output.h"
+#include "config.h"
+
+/**
+ * @brief Amount of flushes that are measured.
+ */
+#define BENCH_FLUSHES	200
+
+/**
+ * @brief System time of the last flush.
+ */
+static volatile gint64	bench_flushed;
+/**
+ * @brief Generation of the audio buffer before the last flush.
+ */
+static volatile unsigned int bench_gen;
+/**
+ * @brief Latency of the last flush in microseconds, or -1 when it has
+ *        not been measured yet.
+ */
+static volatile gint64	bench_latency;
+/**
+ * @brief Whether the threads should terminate.
+ */
+static volatile int	bench_quit = 0;
+
+/**
+ * @brief Buffer size as it would be read from the configuration file.
+ */
+unsigned int
+config_getopt_number(const char *val)
+{
+	return (128);
+}
+
+/**
+ * @brief Fill the audio buffer with silence, like the decoder thread.
+ */
+static void *
+bench_decoder(void *unused)
+{
+	struct audio_chunk *ac;
+	unsigned int ev;
+
+	while (!g_atomic_int_get(&bench_quit)) {
+		ev = audio_buffer_events();
+		if ((ac = audio_buffer_write_begin()) == NULL) {
+			audio_buffer_wait(ev);
+			continue;
+		}
+		ac->fd = NULL;
+		ac->srate = 44100;
+		ac->channels = 2;
+		ac->frame = 0;
+		ac->len = AUDIO_CHUNK_LEN;
+		memset(ac->buf, 0, sizeof ac->buf);
+		audio_buffer_write_end();
+	}
+
+	return (NULL);
+}
+
+/**
+ * @brief Play the audio buffer, like the output thread, and record
+ *        when it stops writing audio that has been flushed.
+ */
+static void *
+bench_output(void *unused)
+{
+	struct audio_chunk *ac;
+	unsigned int ev;
+
+	while (!g_atomic_int_get(&bench_quit)) {
+		/* Anything written from now on has not been flushed */
+		if (bench_latency < 0 &&
+		    audio_buffer_generation() != bench_gen)
+			bench_latency = g_get_monotonic_time() - bench_flushed;
+
+		ev = audio_buffer_events();
+		if ((ac = audio_buffer_read_begin()) == NULL) {
+			audio_buffer_wait(ev);
+			continue;
+		}
+		audio_output_play(ac);
+		audio_buffer_read_end();
+	}
+
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	GThread *dec, *out;
+	gint64 lat, min = G_MAXINT64, max = 0, sum = 0;
+	int i;
+
+	audio_buffer_init();
+	dec = g_thread_new("decoder", bench_decoder, NULL);
+	out = g_thread_new("output", bench_output, NULL);
+
+	for (i = 0; i < BENCH_FLUSHES; i++) {
+		/* Flush at a random point within a chunk */
+		g_usleep(g_random_int_range(20000, 60000));
+		bench_gen = audio_buffer_generation();
+		bench_latency = -1;
+		bench_flushed = g_get_monotonic_time();
+		audio_buffer_flush();
+		while ((lat = bench_latency) < 0)
+			g_usleep(100);
+
+		min = MIN(min, lat);
+		max = MAX(max, lat);
+		sum += lat;
+	}
+
+	printf("chunk of %d samples: %.1f ms of audio\n", AUDIO_CHUNK_LEN,
+	    AUDIO_CHUNK_LEN / 2 * 1000.0 / 44100);
+	printf("flush to silence over %d flushes: "
+	    "min %.2f ms, avg %.2f ms, max %.2f ms\n", BENCH_FLUSHES,
+	    min / 1000.0, sum / 1000.0 / BENCH_FLUSHES, max / 1000.0);
+
+	g_atomic_int_set(&bench_quit, 1);
+	audio_buffer_wakeup();
+	g_thread_join(dec);
+	g_thread_join(out);
+	return (0);
+}
@@ -0,0 +1,105 @@
+#!/bin/sh
+#
+# Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 1. Redistributions of source code must retain the above copyright
+#    notice, this list of conditions and the following disclaimer.
+# 2. Redistributions in binary form must reproduce the above copyright
+#    notice, this list of conditions and the following disclaimer in the
+#    documentation and/or other materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+# ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+# OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+# HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+# SUCH DAMAGE.
+#
+# Test the httpd audio output with local curl listeners. Start herrie
+# built with `./configure httpd' and let it play, then run:
+#
+#	tools/httpdtest.sh [url [listeners [seconds]]]
+#
+# The listeners should stay connected and receive the stream at the
+# speed it is played. Another listener reads at $SLOWRATE bytes per
+# second (64k by default), which must be less than the stream. It should
+# be disconnected and see the end of the stream after reading the audio
+# still buffered by the kernel, before the test ends.
+#
+
+URL=${1:-http://localhost:8000/}
+LISTENERS=${2:-8}
+DURATION=${3:-20}
+SLOWRATE=${SLOWRATE:-64k}
+TMP=`mktemp -d` || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# Exit status 28 means curl was still connected when its time was up
+i=0
+while [ $i -lt $LISTENERS ]
+do
+	(curl -s --max-time $DURATION -o "$TMP/$i" "$URL"; echo $? > "$TMP/$i.ret") &
+	i=`expr $i + 1`
+done
+(curl -s --max-time $DURATION --limit-rate $SLOWRATE -o "$TMP/slow" "$URL";
+    echo $? > "$TMP/slow.ret") &
+wait
+
+FAIL=0
+i=0
+while [ $i -lt $LISTENERS ]
+do
+	RET=`cat "$TMP/$i.ret"`
+	SIZE=`wc -c < "$TMP/$i" | tr -d ' '`
+	if [ "$RET" != 28 ]
+	then
+		echo "listener $i: disconnected (curl status $RET)"
+		FAIL=1
+		i=`expr $i + 1`
+		continue
+	fi
+
+	if [ "`head -c 4 "$TMP/$i"`" = RIFF ]
+	then
+		# Bytes per second from the WAV header
+		RATE=`od -A n -t u4 -j 28 -N 4 "$TMP/$i" | tr -d ' '`
+		KBPS=`expr $SIZE / $DURATION / 1024`
+		echo "listener $i: $SIZE bytes, $KBPS KiB/s of $RATE bytes/s"
+		# Allow for the time it takes to connect
+		if [ `expr $SIZE \* 10` -lt `expr $RATE \* $DURATION \* 8` ]
+		then
+			echo "listener $i: received too little audio"
+			FAIL=1
+		fi
+	else
+		echo "listener $i: $SIZE bytes"
+		if [ $SIZE -eq 0 ]
+		then
+			echo "listener $i: received no audio"
+			FAIL=1
+		fi
+	fi
+	i=`expr $i + 1`
+done
+
+RET=`cat "$TMP/slow.ret"`
+SIZE=`wc -c < "$TMP/slow" | tr -d ' '`
+if [ "$RET" = 28 ]
+then
+	echo "slow listener: still connected after $SIZE bytes"
+	FAIL=1
+else
+	echo "slow listener: disconnected after $SIZE bytes (curl status $RET)"
+fi
+
+[ $FAIL -eq 0 ] && echo "passed" || echo "failed"
+exit $FAIL
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2006-2011 Ed Schouten <ed@80386.nl>
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+/**
+ * @file simtest.c
+ * @brief Drive the simulated audio output with the real audio buffer
+ *        and report the amount of underruns, so buffering changes can
+ *        be tested without a sound device.
+ *
+ * Build it from the source directory:
+ *
+ * cc -O2 -Isrc `pkg-config --cflags glib-2.0` tools/simtest.c \
+ *     src/audio_buffer.c src/audio_output_sim.c \
+ *     `pkg-config --libs glib-2.0` -o simtest
+ *
+ * Options of the simulated device are passed as in the configuration
+ * file, for example:
+ *
+ * ./simtest length=600 audio.output.sim.stall_interval=10 \
+ *     audio.output.sim.stall_time=150000
+ *
+ * length is the amount of seconds of audio that is played. The decoder
+ * can be made to stall for decoder.stall milliseconds after every
+ * decoder.interval seconds of audio. Unless the device runs in
+ * real-time mode, the test runs as fast as possible.
+ */
+
+#include "stdinc.h"
+
+#include "audio_buffer.h"
+#include "audio_output.h"
+#include "config.h"
+
+/**
+ * @brief Options and their default values.
+ */
+static const char *opts[][2] = {
+	{ "audio.buffer.size",			"1024" },
+	{ "audio.output.sim.buffer_time",	"100000" },
+	{ "audio.output.sim.jitter",		"0" },
+	{ "audio.output.sim.period_time",	"25000" },
+	{ "audio.output.sim.realtime",		"no" },
+	{ "audio.output.sim.seed",		"0" },
+	{ "audio.output.sim.stall_interval",	"0" },
+	{ "audio.output.sim.stall_time",	"50000" },
+	{ "decoder.interval",			"0" },
+	{ "decoder.stall",			"0" },
+	{ "length",				"60" },
+};
+/**
+ * @brief Command line arguments overriding the default values.
+ */
+static char		**args;
+/**
+ * @brief Whether the decoder has produced all of the audio.
+ */
+static volatile int	decoder_done = 0;
+
+const char *
+config_getopt(const char *val)
+{
+	size_t len;
+	unsigned int i;
+
+	len = strlen(val);
+	for (i = 0; args[i] != NULL; i++)
+		if (strncmp(args[i], val, len) == 0 && args[i][len] == '=')
+			return (args[i] + len + 1);
+	for (i = 0; i < G_N_ELEMENTS(opts); i++)
+		if (strcmp(opts[i][0], val) == 0)
+			return (opts[i][1]);
+
+	g_printerr("Unknown option %s\n", val);
+	exit(1);
+}
+
+int
+config_getopt_bool(const char *val)
+{
+	return (strcmp(config_getopt(val), "yes") == 0);
+}
+
+unsigned int
+config_getopt_number(const char *val)
+{
+	return (strtoul(config_getopt(val), NULL, 10));
+}
+
+void
+gui_msgbar_warn(const char *msg)
+{
+}
+
+/**
+ * @brief Fill the audio buffer with 44.1 kHz stereo silence, like the
+ *        decoder thread.
+ */
+static void *
+decoder_thread(void *unused)
+{
+	struct audio_chunk *ac;
+	int64_t frame = 0, end, interval, next;
+	unsigned int ev, stall;
+
+	end = (int64_t)config_getopt_number("length") * 44100;
+	interval = (int64_t)config_getopt_number("decoder.interval") * 44100;
+	stall = config_getopt_number("decoder.stall");
+	next = interval;
+
+	while (frame < end) {
+		if (interval != 0 && frame >= next) {
+			/* Decoding takes longer than usual */
+			g_usleep(stall * 1000);
+			next += interval;
+		}
+
+		ev = audio_buffer_events();
+		if ((ac = audio_buffer_write_begin()) == NULL) {
+			audio_buffer_wait(ev);
+			continue;
+		}
+		ac->fd = NULL;
+		ac->srate = 44100;
+		ac->channels = 2;
+		ac->frame = frame;
+		ac->len = AUDIO_CHUNK_LEN;
+		memset(ac->buf, 0, sizeof ac->buf);
+		audio_buffer_write_end();
+		frame += AUDIO_CHUNK_LEN / 2;
+	}
+
+	g_atomic_int_set(&decoder_done, 1);
+	audio_buffer_wakeup();
+	return (NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	GThread *dec;
+	struct audio_chunk *ac;
+	unsigned int ev;
+
+	args = argv + 1;
+	audio_buffer_init();
+	if (audio_output_open() != 0)
+		return (1);
+	dec = g_thread_new("decoder", decoder_thread, NULL);
+
+	/* Play the audio buffer, like the output thread */
+	for (;;) {
+		ev = audio_buffer_events();
+		if ((ac = audio_buffer_read_begin()) != NULL) {
+			audio_output_play(ac);
+			audio_buffer_read_end();
+		} else if (g_atomic_int_get(&decoder_done)) {
+			break;
+		} else {
+			audio_buffer_wait(ev);
+		}
+	}
+
+	g_thread_join(dec);
+	/* Prints the statistics on exit */
+	audio_output_close();
+	return (0);
+}